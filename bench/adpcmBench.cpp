@@ -0,0 +1,135 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <yunikEngine/adpcm.hpp>
+
+using namespace yunikEngine;
+
+/* ADPCM against PCM on 60 seconds of random 44.1 kHz blocks: the memory
+ * each takes, the time to read each from a file, and the time to decode the
+ * ADPCM. The whole-chunk decoders (SSE2 when available) are checked against
+ * the one block at a time decoders. Exits with 1 when a check fails. */
+
+static int failureCount = 0;
+
+static void check (bool isPassed, const char* name) {
+    printf("%s: %s\n", isPassed ? "pass" : "FAIL", name);
+    if (!isPassed) {
+        ++failureCount;
+    }
+}
+
+static std::vector<unsigned char> randomBlocks (size_t bytes, int blockAlign, int headerBytes, int channels) {
+    std::mt19937 random(99);
+    std::vector<unsigned char> data(bytes);
+    for (auto& byte : data) {
+        byte = (unsigned char) random();
+    }
+    /* Keep the IMA step indices of the headers in range */
+    if (headerBytes == 4) {
+        for (size_t block = 0; block + blockAlign <= bytes; block += blockAlign) {
+            for (int channel = 0; channel < channels; ++channel) {
+                data[block + 4 * channel + 2] %= 89;
+                data[block + 4 * channel + 3] = 0;
+            }
+        }
+    }
+    return data;
+}
+
+static double msSince (const std::chrono::steady_clock::time_point& start) {
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+/* Time to read size bytes back from a temporary file, warm in the page
+ * cache, the way loadWAV reads the data chunk */
+static double loadMs (const void* data, size_t size) {
+    FILE* fp = tmpfile();
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot create temporary file\n");
+        return -1.0;
+    }
+    fwrite(data, 1, size, fp);
+    std::vector<unsigned char> buf(size);
+    rewind(fp);
+    fread(buf.data(), 1, size, fp);
+
+    rewind(fp);
+    const auto start = std::chrono::steady_clock::now();
+    const size_t readSize = fread(buf.data(), 1, size, fp);
+    const double elapsed = msSince(start);
+    fclose(fp);
+    return readSize == size ? elapsed : -1.0;
+}
+
+static void bench (bool isIMA, int channels) {
+    const int blockAlign = (isIMA ? 512 : 256) * channels;
+    const int samples = isIMA ? adpcm::imaSamplesPerBlock(blockAlign, channels) : adpcm::msSamplesPerBlock(blockAlign, channels);
+    const size_t blockCount = 44100 * 60 / samples;
+    const std::vector<unsigned char> data = randomBlocks(blockCount * blockAlign, blockAlign, isIMA ? 4 : 7, channels);
+
+    auto decodeChunk = [&] (std::vector<short>* pcm) {
+        if (isIMA) {
+            adpcm::decodeIMA(data.data(), (unsigned int) data.size(), channels, blockAlign, pcm);
+        } else {
+            adpcm::decodeMS(data.data(), (unsigned int) data.size(), channels, blockAlign, adpcm::ms_standard_coefs, 7, pcm);
+        }
+    };
+
+    /* Warm up so neither timing pays for first-touch page faults */
+    std::vector<short> pcm;
+    decodeChunk(&pcm);
+    auto start = std::chrono::steady_clock::now();
+    decodeChunk(&pcm);
+    const double chunkMs = msSince(start);
+
+    std::vector<short> reference(blockCount * samples * channels, 1);
+    start = std::chrono::steady_clock::now();
+    for (size_t block = 0; block < blockCount; ++block) {
+        const unsigned char* in = data.data() + block * blockAlign;
+        short* out = reference.data() + block * samples * channels;
+        if (isIMA) {
+            adpcm::decodeIMABlock(in, blockAlign, channels, out);
+        } else {
+            adpcm::decodeMSBlock(in, blockAlign, channels, adpcm::ms_standard_coefs, 7, out);
+        }
+    }
+    const double blockMs = msSince(start);
+
+    const size_t pcmBytes = pcm.size() * sizeof(short);
+    printf("%-3s %-6s  %8.2f  %6.2f  %5.2fx  %11.2f  %13.2f  %9.2f  %15.2f\n", isIMA ? "ima" : "ms", channels == 1 ? "mono" : "stereo",
+        data.size() / 1048576.0, pcmBytes / 1048576.0, (double) pcmBytes / data.size(),
+        loadMs(pcm.data(), pcmBytes), loadMs(data.data(), data.size()), chunkMs, blockMs);
+
+    char name[64];
+    snprintf(name, sizeof(name), "%s %s chunk decode matches block decode", isIMA ? "IMA" : "MS", channels == 1 ? "mono" : "stereo");
+    check(pcm == reference, name);
+}
+
+/* A truncated file ends in a short block: only whole 4-byte groups of every
+ * channel may be decoded */
+static void testShortBlock (void) {
+    std::vector<short> out(64);
+    const unsigned char stereoTail[12] = {0};
+    check(adpcm::decodeIMABlock(stereoTail, 12, 2, out.data()) == 1, "IMA stereo 12-byte tail decodes its headers only");
+    const unsigned char stereoTail2[20] = {0};
+    check(adpcm::decodeIMABlock(stereoTail2, 20, 2, out.data()) == 9, "IMA stereo 20-byte tail decodes one group per channel");
+}
+
+int main (void) {
+#ifdef YUNIKENGINE_SSE2
+    printf("SSE2 chunk decoder\n");
+#else
+    printf("scalar chunk decoder\n");
+#endif
+    testShortBlock();
+    printf("\nADPCM is kept as is when uploaded natively, PCM when decoded\n");
+    printf("format      adpcm_MB  pcm_MB  ratio  pcm_load_ms  adpcm_load_ms  decode_ms  block_decode_ms\n");
+    for (bool isIMA : {true, false}) {
+        bench(isIMA, 1);
+        bench(isIMA, 2);
+    }
+    return failureCount > 0 ? 1 : 0;
+}
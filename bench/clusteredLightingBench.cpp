@@ -0,0 +1,68 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+#include <yunikEngine/projectManager.hpp>
+#include <yunikEngine/clusteredLighting.hpp>
+
+using namespace yunikEngine;
+
+/* Light culling time against the light count, on one thread and on all of
+ * them. Lights are scattered through the view frustum of a 1024x768
+ * perspective camera with a 16x9x24 cluster grid. */
+int main (void) {
+    if (!init()) {
+        return 1;
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    Window* window = Window::create();
+    if (window == nullptr) {
+        deinit();
+        return 1;
+    }
+
+    Camera* camera = Camera::create(false, 1024.0f, 768.0f);
+    camera->setDepth(0.1f, 100.0f);
+    ClusteredLighting* clusteredLighting = ClusteredLighting::create(16, 9, 24);
+
+    const int hardwareThreads = std::max(1, (int) std::thread::hardware_concurrency());
+    const int lightCounts[] = {64, 256, 1024, 4096, 16384};
+    const int iterations = 100;
+    std::mt19937 random(1234);
+
+    printf("lights  threads  cull_ms  light_refs\n");
+    for (int lightCount : lightCounts) {
+        std::uniform_real_distribution<float> depth(1.0f, 100.0f);
+        std::uniform_real_distribution<float> side(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> radius(0.5f, 4.0f);
+        std::vector<Light> lights(lightCount);
+        for (auto& light : lights) {
+            const float d = depth(random);
+            light.position = glm::vec3(side(random) * d * 0.77f, side(random) * d * 0.58f, -d);
+            light.radius = radius(random);
+        }
+
+        for (int threads : {1, hardwareThreads}) {
+            clusteredLighting->setThreadCount(threads);
+            clusteredLighting->cull(camera, lights);
+
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; ++i) {
+                clusteredLighting->cull(camera, lights);
+            }
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            printf("%6d  %7d  %7.3f  %10zu\n", lightCount, threads, elapsed.count() / iterations, clusteredLighting->getLightIndexCount());
+
+            if (hardwareThreads == 1) {
+                break;
+            }
+        }
+    }
+
+    clusteredLighting->destroy();
+    camera->destroy();
+    window->destroy();
+    deinit();
+    return 0;
+}
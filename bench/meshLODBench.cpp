@@ -0,0 +1,170 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <yunikEngine/projectManager.hpp>
+#include <yunikEngine/mesh.hpp>
+
+using namespace yunikEngine;
+
+/* Dense crowd: 64x64 instances of a 36864-triangle mesh, 1.5 units apart,
+ * seen by a 1024x768 camera walking into the crowd. Each mode renders the
+ * same frames at full detail and then with LOD selection, and reports
+ * triangles submitted and frame time (CPU submission plus glFinish, vsync
+ * off). */
+
+static const int crowd_size = 64;
+static const int frame_num = 150;
+
+/* Bumpy sphere with a UV seam */
+static Mesh* createCrowdMesh (void) {
+    const int rings = 96;
+    const int segments = 192;
+    std::vector<MeshVertex> vertices;
+    std::vector<unsigned int> indices;
+    for (int i = 0; i <= rings; ++i) {
+        for (int j = 0; j <= segments; ++j) {
+            const float theta = 3.14159265f * i / rings;
+            const float phi = 6.28318531f * j / segments;
+            const glm::vec3 normal(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            MeshVertex vertex;
+            vertex.position = normal * (0.5f + 0.04f * std::sin(7.0f * theta) * std::cos(9.0f * phi));
+            vertex.normal = normal;
+            vertex.color = glm::vec3(0.8f, 0.6f, 0.4f);
+            vertices.push_back(vertex);
+        }
+    }
+    for (int i = 0; i < rings; ++i) {
+        for (int j = 0; j < segments; ++j) {
+            const unsigned int a = i * (segments + 1) + j;
+            const unsigned int b = a + 1;
+            const unsigned int c = a + segments + 1;
+            const unsigned int d = c + 1;
+            const unsigned int quad[6] = {a, b, c, b, d, c};
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    Mesh* mesh = Mesh::create(vertices, indices, {0.5f, 0.25f, 0.125f, 0.0625f, 0.03125f});
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    if (mesh != nullptr) {
+        printf("LOD chain built in %.1f ms:", elapsed.count());
+        for (int lod = 0; lod < mesh->getLODCount(); ++lod) {
+            printf(" %d", mesh->getTriangleCount(lod));
+        }
+        printf(" triangles\n");
+    }
+    return mesh;
+}
+
+static ShaderProgram* createProgram (void) {
+    char* vertexSrc = example::simpleVertexShader();
+    char* fragmentSrc = example::simpleFragmentShader();
+    Shader* vertexShader = Shader::create(vertexSrc, ShaderType::VERTEX);
+    Shader* fragmentShader = Shader::create(fragmentSrc, ShaderType::FRAGMENT);
+    delete[] vertexSrc;
+    delete[] fragmentSrc;
+
+    ShaderProgram* program = ShaderProgram::create();
+    if (program != nullptr && vertexShader != nullptr && fragmentShader != nullptr) {
+        program->attachShader(vertexShader);
+        program->attachShader(fragmentShader);
+        Mesh::bindAttribLocations(program);
+        if (!program->compile()) {
+            program->destroy();
+            program = nullptr;
+        }
+    }
+    if (vertexShader != nullptr) {
+        vertexShader->destroy();
+    }
+    if (fragmentShader != nullptr) {
+        fragmentShader->destroy();
+    }
+    return program;
+}
+
+int main (void) {
+    if (!init()) {
+        return 1;
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    Window* window = Window::create();
+    if (window == nullptr) {
+        deinit();
+        return 1;
+    }
+    glfwSwapInterval(0);
+    glEnable(GL_DEPTH_TEST);
+
+    Mesh* mesh = createCrowdMesh();
+    ShaderProgram* program = createProgram();
+    if (mesh == nullptr || program == nullptr) {
+        window->destroy();
+        deinit();
+        return 1;
+    }
+
+    int width, height;
+    window->getDefaultSize(&width, &height);
+    Camera* camera = Camera::create(false, (float) width, (float) height);
+    camera->setDepth(0.1f, 200.0f);
+
+    std::vector<glm::mat4> models;
+    for (int x = 0; x < crowd_size; ++x) {
+        for (int z = 0; z < crowd_size; ++z) {
+            glm::mat4 model(1.0f);
+            model[3] = glm::vec4(x * 1.5f - crowd_size * 0.75f, 0.0f, -z * 1.5f - 1.0f, 1.0f);
+            models.push_back(model);
+        }
+    }
+
+    Stats::setEnabled(true);
+    const int triangleCounter = static_cast<int>(StatCounter::TRIANGLES);
+    printf("mode   frame_ms  triangles_per_frame\n");
+    for (bool isLODEnabled : {false, true}) {
+        std::vector<int> lods(models.size(), 0);
+        double frameTime = 0.0;
+        uint64_t triangles = 0;
+
+        for (int frame = 0; frame < frame_num; ++frame) {
+            const auto start = std::chrono::steady_clock::now();
+
+            const float cameraZ = 2.0f - frame * 0.5f;
+            camera->setViewMatrix(glm::vec3(0.0f, 1.0f, cameraZ), glm::vec3(0.0f, 1.0f, cameraZ - 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            const glm::mat4 viewMatrix = camera->getViewMatrix();
+
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            program->use();
+            program->setMat4("uProjMatrix", camera->getProjMatrix());
+            for (size_t i = 0; i < models.size(); ++i) {
+                if (isLODEnabled) {
+                    lods[i] = mesh->selectLOD(lods[i], camera, models[i], (float) height);
+                }
+                /* Models are translations only, so normals need no inverse */
+                const glm::mat4 modelViewMatrix = viewMatrix * models[i];
+                program->setMat4("uModelViewMatrix", modelViewMatrix);
+                program->setMat4("uNormalMatrix", modelViewMatrix);
+                mesh->draw(lods[i]);
+            }
+            glFinish();
+
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            frameTime += elapsed.count();
+            Stats::closeUpdate();
+            Stats::endFrame();
+            triangles += Stats::getSnapshot().perFrame[triangleCounter];
+            glfwPollEvents();
+        }
+
+        printf("%-5s  %8.2f  %19llu\n", isLODEnabled ? "lod" : "full", frameTime / frame_num, (unsigned long long) (triangles / frame_num));
+    }
+
+    camera->destroy();
+    program->destroy();
+    mesh->destroy();
+    window->destroy();
+    deinit();
+    return 0;
+}
@@ -0,0 +1,247 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+#include <yunikEngine/occlusionCulling.hpp>
+
+using namespace yunikEngine;
+
+/* Accuracy checks of OcclusionCuller on synthetic scenes, then its timings.
+ * Exits with 1 when a check fails. */
+
+static int failureCount = 0;
+
+static void check (bool isPassed, const char* name) {
+    printf("%s: %s\n", isPassed ? "pass" : "FAIL", name);
+    if (!isPassed) {
+        ++failureCount;
+    }
+}
+
+static glm::mat4 translation (glm::vec3 offset) {
+    glm::mat4 matrix(1.0f);
+    matrix[3] = glm::vec4(offset, 1.0f);
+    return matrix;
+}
+
+/* Axis aligned box as 12 triangles */
+static void addBox (glm::vec3 boxMin, glm::vec3 boxMax, std::vector<glm::vec3>* vertices, std::vector<unsigned int>* indices) {
+    const unsigned int base = (unsigned int) vertices->size();
+    for (int corner = 0; corner < 8; ++corner) {
+        vertices->push_back(glm::vec3((corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y, (corner & 4) ? boxMax.z : boxMin.z));
+    }
+    const unsigned int faces[36] = {
+        0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6,
+        0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7,
+        0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5
+    };
+    for (unsigned int index : faces) {
+        indices->push_back(base + index);
+    }
+}
+
+/* Quad facing +z at depth z */
+static void addWall (float halfWidth, float halfHeight, float z, std::vector<glm::vec3>* vertices, std::vector<unsigned int>* indices) {
+    const unsigned int base = (unsigned int) vertices->size();
+    vertices->push_back(glm::vec3(-halfWidth, -halfHeight, z));
+    vertices->push_back(glm::vec3(halfWidth, -halfHeight, z));
+    vertices->push_back(glm::vec3(halfWidth, halfHeight, z));
+    vertices->push_back(glm::vec3(-halfWidth, halfHeight, z));
+    const unsigned int faces[6] = {0, 1, 2, 0, 2, 3};
+    for (unsigned int index : faces) {
+        indices->push_back(base + index);
+    }
+}
+
+static void testWall (OcclusionCuller* culler, Camera* camera) {
+    std::vector<glm::vec3> vertices;
+    std::vector<unsigned int> indices;
+    addWall(4.0f, 4.0f, -10.0f, &vertices, &indices);
+
+    culler->begin(camera);
+    culler->addOccluder(vertices, indices, glm::mat4(1.0f));
+    culler->rasterize();
+
+    const glm::mat4 identity(1.0f);
+    check(!culler->isVisible(glm::vec3(-1.0f, -1.0f, -21.0f), glm::vec3(1.0f, 1.0f, -20.0f), identity), "wall hides a box behind it");
+    check(culler->isVisible(glm::vec3(-1.0f, -1.0f, -6.0f), glm::vec3(1.0f, 1.0f, -5.0f), identity), "wall keeps a box in front visible");
+    check(culler->isVisible(glm::vec3(3.0f, -1.0f, -21.0f), glm::vec3(12.0f, 1.0f, -20.0f), identity), "box sticking out of the wall is visible");
+    check(culler->isVisible(glm::vec3(-1.0f, -1.0f, -1.0f), glm::vec3(1.0f, 1.0f, 1.0f), identity), "box around the camera is visible");
+}
+
+static void testBox (OcclusionCuller* culler, Camera* camera) {
+    std::vector<glm::vec3> vertices;
+    std::vector<unsigned int> indices;
+    addBox(glm::vec3(-2.0f), glm::vec3(2.0f), &vertices, &indices);
+
+    culler->begin(camera);
+    culler->addOccluder(vertices, indices, translation(glm::vec3(0.0f, 0.0f, -10.0f)));
+    culler->rasterize();
+
+    check(!culler->isVisible(glm::vec3(-0.5f), glm::vec3(0.5f), translation(glm::vec3(0.0f, 0.0f, -20.0f))), "box occluder hides a smaller box");
+    check(culler->isVisible(glm::vec3(-10.0f), glm::vec3(10.0f), translation(glm::vec3(0.0f, 0.0f, -40.0f))), "box occluder leaves a larger box visible");
+    check(culler->isVisible(glm::vec3(-0.5f), glm::vec3(0.5f), translation(glm::vec3(0.0f, 0.0f, -5.0f))), "box in front of the box occluder is visible");
+}
+
+/* Occluders between the camera and its near plane are clipped by GL, so
+ * they must not hide anything */
+static void testNearPlane (OcclusionCuller* culler) {
+    Camera* camera = Camera::create(false, 256.0f, 256.0f);
+    camera->setDepth(1.0f, 100.0f);
+
+    std::vector<glm::vec3> vertices;
+    std::vector<unsigned int> indices;
+    addWall(4.0f, 4.0f, -0.5f, &vertices, &indices);
+
+    culler->begin(camera);
+    culler->addOccluder(vertices, indices, glm::mat4(1.0f));
+    culler->rasterize();
+
+    check(culler->isVisible(glm::vec3(-1.0f, -1.0f, -11.0f), glm::vec3(1.0f, 1.0f, -10.0f), glm::mat4(1.0f)), "occluder closer than zNear hides nothing");
+    camera->destroy();
+}
+
+static void testOrtho (OcclusionCuller* culler) {
+    Camera* camera = Camera::create(true, 20.0f, 20.0f);
+    camera->setViewport(-10.0f, 10.0f, -10.0f, 10.0f);
+    camera->setDepth(0.0f, 100.0f);
+    const glm::mat4 identity(1.0f);
+
+    std::vector<glm::vec3> vertices;
+    std::vector<unsigned int> indices;
+    addWall(4.0f, 4.0f, 5.0f, &vertices, &indices);
+    culler->begin(camera);
+    culler->addOccluder(vertices, indices, identity);
+    culler->rasterize();
+    check(culler->isVisible(glm::vec3(-1.0f, -1.0f, -11.0f), glm::vec3(1.0f, 1.0f, -10.0f), identity), "ortho: occluder behind the camera hides nothing");
+
+    vertices.clear();
+    indices.clear();
+    addWall(4.0f, 4.0f, -10.0f, &vertices, &indices);
+    culler->begin(camera);
+    culler->addOccluder(vertices, indices, identity);
+    culler->rasterize();
+    check(!culler->isVisible(glm::vec3(-1.0f, -1.0f, -21.0f), glm::vec3(1.0f, 1.0f, -20.0f), identity), "ortho: wall hides a box behind it");
+    check(culler->isVisible(glm::vec3(-1.0f, -1.0f, -6.0f), glm::vec3(1.0f, 1.0f, -5.0f), identity), "ortho: wall keeps a box in front visible");
+
+    camera->destroy();
+}
+
+/* Random boxes in front of the camera */
+static void buildScene (int boxCount, std::vector<glm::vec3>* vertices, std::vector<unsigned int>* indices) {
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> side(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> depth(5.0f, 80.0f);
+    std::uniform_real_distribution<float> size(0.5f, 3.0f);
+    for (int i = 0; i < boxCount; ++i) {
+        const float z = depth(random);
+        const glm::vec3 center(side(random) * z * 0.6f, side(random) * z * 0.45f, -z);
+        const glm::vec3 extent(size(random), size(random), size(random));
+        addBox(center - extent, center + extent, vertices, indices);
+    }
+}
+
+static void testAVX2Parity (OcclusionCuller* culler, Camera* camera) {
+#ifndef YUNIKENGINE_AVX2
+    /* setAVX2Enabled does nothing without the AVX2 path */
+    (void) culler;
+    (void) camera;
+    printf("skip: scalar and AVX2 depth buffers match (built without YUNIKENGINE_AVX2)\n");
+#else
+    std::vector<glm::vec3> vertices;
+    std::vector<unsigned int> indices;
+    buildScene(200, &vertices, &indices);
+
+    int width, height;
+    culler->getSize(&width, &height);
+    std::vector<float> scalarDepth(width * height);
+
+    culler->setAVX2Enabled(false);
+    culler->begin(camera);
+    culler->addOccluder(vertices, indices, glm::mat4(1.0f));
+    culler->rasterize();
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            scalarDepth[y * width + x] = culler->getDepth(x, y);
+        }
+    }
+
+    culler->setAVX2Enabled(true);
+    culler->rasterize();
+    int mismatches = 0;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            if (std::fabs(culler->getDepth(x, y) - scalarDepth[y * width + x]) > 1e-6f) {
+                ++mismatches;
+            }
+        }
+    }
+    check(mismatches == 0, "scalar and AVX2 depth buffers match");
+#endif
+}
+
+static double timeMs (const std::chrono::steady_clock::time_point& start, int iterations) {
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+static void benchmark (OcclusionCuller* culler, Camera* camera) {
+    std::vector<glm::vec3> vertices;
+    std::vector<unsigned int> indices;
+    buildScene(200, &vertices, &indices);
+
+    const int iterations = 50;
+    const int hardwareThreads = std::max(1, (int) std::thread::hardware_concurrency());
+    printf("\n%zu occluder triangles\n", indices.size() / 3);
+    printf("path    threads  rasterize_ms\n");
+    for (bool isAVX2 : {false, true}) {
+        culler->setAVX2Enabled(isAVX2);
+        for (int threads : {1, hardwareThreads}) {
+            culler->setThreadCount(threads);
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; ++i) {
+                culler->begin(camera);
+                culler->addOccluder(vertices, indices, glm::mat4(1.0f));
+                culler->rasterize();
+            }
+            printf("%-6s  %7d  %12.3f\n", isAVX2 ? "avx2" : "scalar", threads, timeMs(start, iterations));
+            if (hardwareThreads == 1) {
+                break;
+            }
+        }
+    }
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> side(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> depth(5.0f, 90.0f);
+    std::vector<glm::vec3> centers(10000);
+    for (auto& center : centers) {
+        const float z = depth(random);
+        center = glm::vec3(side(random) * z * 0.6f, side(random) * z * 0.45f, -z);
+    }
+    int visibleCount = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const glm::vec3& center : centers) {
+        visibleCount += culler->isVisible(center - glm::vec3(0.5f), center + glm::vec3(0.5f), glm::mat4(1.0f)) ? 1 : 0;
+    }
+    printf("isVisible: %zu boxes in %.3f ms, %d visible\n", centers.size(), timeMs(start, 1), visibleCount);
+}
+
+int main (void) {
+    OcclusionCuller* culler = OcclusionCuller::create(256, 128);
+    Camera* camera = Camera::create(false, 256.0f, 128.0f);
+    camera->setDepth(0.1f, 100.0f);
+
+    testWall(culler, camera);
+    testBox(culler, camera);
+    testNearPlane(culler);
+    testOrtho(culler);
+    testAVX2Parity(culler, camera);
+    benchmark(culler, camera);
+
+    camera->destroy();
+    culler->destroy();
+    return failureCount > 0 ? 1 : 0;
+}
@@ -0,0 +1,360 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define YUNIKENGINE_SSE2
+#endif
+
+namespace yunikEngine {
+    /**************************************************************************/
+    /*                                 ADPCM                                  */
+    /**************************************************************************/
+    /* Decoders for the ADPCM flavours found in WAV files. Both work one block
+     * at a time, so they can be used for load time decoding as well as for
+     * streaming. Output is interleaved 16-bit PCM. Whole chunks decode four
+     * channel streams at a time with SSE2. */
+    namespace adpcm {
+        const int ima_step_table[89] = {
+            7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37,
+            41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173,
+            190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+            724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+            2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894,
+            6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289,
+            16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+        };
+
+        const int ima_index_table[16] = {
+            -1, -1, -1, -1, 2, 4, 6, 8,
+            -1, -1, -1, -1, 2, 4, 6, 8
+        };
+
+        const int ms_adaptation_table[16] = {
+            230, 230, 230, 230, 307, 409, 512, 614,
+            768, 614, 512, 409, 307, 230, 230, 230
+        };
+
+        /* Coefficient pairs every MS ADPCM encoder writes */
+        const short ms_standard_coefs[14] = {
+            256, 0, 512, -256, 0, 0, 192, 64, 240, 0, 460, -208, 392, -232
+        };
+
+        /* Keeps delta * 768 in an int on garbage input */
+        const int ms_max_delta = 0x7FFFFFFF / 768;
+
+#ifdef YUNIKENGINE_SSE2
+        /* Low 32 bits of a * b per lane, SSE2 has no pmulld */
+        inline __m128i mullo32 (__m128i a, __m128i b) {
+            const __m128i even = _mm_mul_epu32(a, b);
+            const __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+            return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        }
+
+        /* 32-bit min and max, SSE2 only has them for 16-bit lanes */
+        inline __m128i min32 (__m128i a, __m128i b) {
+            const __m128i isOver = _mm_cmpgt_epi32(a, b);
+            return _mm_or_si128(_mm_and_si128(isOver, b), _mm_andnot_si128(isOver, a));
+        }
+
+        inline __m128i max32 (__m128i a, __m128i b) {
+            const __m128i isUnder = _mm_cmpgt_epi32(b, a);
+            return _mm_or_si128(_mm_and_si128(isUnder, b), _mm_andnot_si128(isUnder, a));
+        }
+#endif
+
+        /*********************** IMA (DVI) ADPCM ******************************/
+        /* Only whole 4-byte groups of every channel are decoded, so a short
+         * last block never reads past its end */
+        inline int imaSamplesPerBlock (int blockAlign, int channels) {
+            return (blockAlign - 4 * channels) / (4 * channels) * 8 + 1;
+        }
+
+        /* Byte offset of nibble k (k >= 1) of a channel in an IMA block. Data
+         * is interleaved in 4-byte groups of 8 samples per channel, low nibble
+         * first. */
+        inline int imaNibbleOffset (int k, int channel, int channels) {
+            const int n = k - 1;
+            return 4 * channels + ((n >> 3) * channels + channel) * 4 + ((n & 7) >> 1);
+        }
+
+        inline int imaNibble (const unsigned char* block, int k, int channel, int channels) {
+            const unsigned char byte = block[imaNibbleOffset(k, channel, channels)];
+            return ((k - 1) & 1) ? (byte >> 4) : (byte & 0x0F);
+        }
+
+        /* Decode one block of blockBytes (may be a short last block) into
+         * out. Returns the number of samples per channel written. */
+        inline int decodeIMABlock (const unsigned char* block, int blockBytes, int channels, short* out) {
+            if (blockBytes < 4 * channels) {
+                return 0;
+            }
+            const int samples = imaSamplesPerBlock(blockBytes, channels);
+
+            for (int channel = 0; channel < channels; ++channel) {
+                const unsigned char* header = block + 4 * channel;
+                int predictor = (short) (header[0] | (header[1] << 8));
+                int index = std::min(std::max((int) header[2], 0), 88);
+                out[channel] = (short) predictor;
+
+                for (int k = 1; k < samples; ++k) {
+                    const int nibble = imaNibble(block, k, channel, channels);
+                    const int step = ima_step_table[index];
+                    int diff = step >> 3;
+                    if (nibble & 4) diff += step;
+                    if (nibble & 2) diff += step >> 1;
+                    if (nibble & 1) diff += step >> 2;
+                    predictor += (nibble & 8) ? -diff : diff;
+                    predictor = std::min(std::max(predictor, -32768), 32767);
+                    index = std::min(std::max(index + ima_index_table[nibble], 0), 88);
+                    out[k * channels + channel] = (short) predictor;
+                }
+            }
+            return samples;
+        }
+
+        /* Decode a whole IMA ADPCM data chunk */
+        inline void decodeIMA (const unsigned char* data, unsigned int dataSize, int channels, int blockAlign, std::vector<short>* pcm) {
+            const int samples = imaSamplesPerBlock(blockAlign, channels);
+            const unsigned int blockCount = dataSize / blockAlign;
+            const unsigned int tailBytes = dataSize % blockAlign;
+            pcm->resize(((size_t) blockCount * samples + (tailBytes ? samples : 0)) * channels);
+
+            short* out = pcm->data();
+            unsigned int block = 0;
+#ifdef YUNIKENGINE_SSE2
+            /* Blocks are independent: each SSE lane follows one channel of one
+             * block, four streams per pass. Table lookups stay scalar. */
+            const unsigned int streamsPerBlock = channels;
+            if (4 % streamsPerBlock == 0) {
+                const unsigned int blocksPerPass = 4 / streamsPerBlock;
+                for (; block + blocksPerPass <= blockCount; block += blocksPerPass) {
+                    const unsigned char* laneBlock[4];
+                    short* laneOut[4];
+                    int laneChannel[4], predictor[4], index[4];
+                    for (int lane = 0; lane < 4; ++lane) {
+                        const unsigned int laneBlockIndex = block + lane / channels;
+                        laneBlock[lane] = data + (size_t) laneBlockIndex * blockAlign;
+                        laneChannel[lane] = lane % channels;
+                        laneOut[lane] = out + (size_t) laneBlockIndex * samples * channels + laneChannel[lane];
+
+                        const unsigned char* header = laneBlock[lane] + 4 * laneChannel[lane];
+                        predictor[lane] = (short) (header[0] | (header[1] << 8));
+                        index[lane] = std::min(std::max((int) header[2], 0), 88);
+                        laneOut[lane][0] = (short) predictor[lane];
+                    }
+
+                    __m128i vPredictor = _mm_setr_epi32(predictor[0], predictor[1], predictor[2], predictor[3]);
+                    __m128i vIndex = _mm_setr_epi32(index[0], index[1], index[2], index[3]);
+                    const __m128i one = _mm_set1_epi32(1);
+                    const __m128i two = _mm_set1_epi32(2);
+                    const __m128i four = _mm_set1_epi32(4);
+                    const __m128i eight = _mm_set1_epi32(8);
+                    const __m128i three = _mm_set1_epi32(3);
+                    const __m128i minusOne = _mm_set1_epi32(-1);
+                    const __m128i maxIndex = _mm_set1_epi32(88);
+
+                    alignas(16) int lanes[4];
+                    for (int k = 1; k < samples; ++k) {
+                        _mm_store_si128((__m128i*) lanes, vIndex);
+                        const __m128i step = _mm_setr_epi32(ima_step_table[lanes[0]], ima_step_table[lanes[1]], ima_step_table[lanes[2]], ima_step_table[lanes[3]]);
+                        const __m128i nibble = _mm_setr_epi32(
+                            imaNibble(laneBlock[0], k, laneChannel[0], channels),
+                            imaNibble(laneBlock[1], k, laneChannel[1], channels),
+                            imaNibble(laneBlock[2], k, laneChannel[2], channels),
+                            imaNibble(laneBlock[3], k, laneChannel[3], channels));
+
+                        /* diff = step/8 + step*b2 + step/2*b1 + step/4*b0 */
+                        __m128i diff = _mm_srai_epi32(step, 3);
+                        diff = _mm_add_epi32(diff, _mm_and_si128(step, _mm_cmpeq_epi32(_mm_and_si128(nibble, four), four)));
+                        diff = _mm_add_epi32(diff, _mm_and_si128(_mm_srai_epi32(step, 1), _mm_cmpeq_epi32(_mm_and_si128(nibble, two), two)));
+                        diff = _mm_add_epi32(diff, _mm_and_si128(_mm_srai_epi32(step, 2), _mm_cmpeq_epi32(_mm_and_si128(nibble, one), one)));
+
+                        /* Conditional negate: (diff ^ sign) - sign */
+                        const __m128i sign = _mm_cmpeq_epi32(_mm_and_si128(nibble, eight), eight);
+                        vPredictor = _mm_add_epi32(vPredictor, _mm_sub_epi32(_mm_xor_si128(diff, sign), sign));
+
+                        /* Saturate to 16 bits and sign extend back */
+                        const __m128i packed = _mm_packs_epi32(vPredictor, vPredictor);
+                        vPredictor = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+
+                        /* index += (n & 4) ? 2 * (n & 3) + 2 : -1, clamped to [0, 88] */
+                        const __m128i isBig = _mm_cmpeq_epi32(_mm_and_si128(nibble, four), four);
+                        const __m128i bigStep = _mm_add_epi32(_mm_slli_epi32(_mm_and_si128(nibble, three), 1), two);
+                        vIndex = _mm_add_epi32(vIndex, _mm_or_si128(_mm_and_si128(isBig, bigStep), _mm_andnot_si128(isBig, minusOne)));
+                        vIndex = _mm_and_si128(vIndex, _mm_cmpgt_epi32(vIndex, minusOne));
+                        const __m128i isOver = _mm_cmpgt_epi32(vIndex, maxIndex);
+                        vIndex = _mm_or_si128(_mm_and_si128(isOver, maxIndex), _mm_andnot_si128(isOver, vIndex));
+
+                        _mm_store_si128((__m128i*) lanes, vPredictor);
+                        for (int lane = 0; lane < 4; ++lane) {
+                            laneOut[lane][k * channels] = (short) lanes[lane];
+                        }
+                    }
+                }
+            }
+#endif
+            for (; block < blockCount; ++block) {
+                decodeIMABlock(data + (size_t) block * blockAlign, blockAlign, channels, out + (size_t) block * samples * channels);
+            }
+            if (tailBytes) {
+                const int tailSamples = decodeIMABlock(data + (size_t) blockCount * blockAlign, tailBytes, channels, out + (size_t) blockCount * samples * channels);
+                pcm->resize(((size_t) blockCount * samples + tailSamples) * channels);
+            }
+        }
+
+        /*************************** MS ADPCM *********************************/
+        inline int msSamplesPerBlock (int blockAlign, int channels) {
+            return (blockAlign - 7 * channels) * 2 / channels + 2;
+        }
+
+        /* Nibble of sample k (k >= 2) of a channel in an MS block. Nibbles
+         * follow the headers high nibble first, channels alternating. */
+        inline int msNibble (const unsigned char* block, int k, int channel, int channels) {
+            const int i = (k - 2) * channels + channel;
+            const unsigned char byte = block[7 * channels + (i >> 1)];
+            return (i & 1) ? (byte & 0x0F) : (byte >> 4);
+        }
+
+        /* coefs holds coefCount (coef1, coef2) pairs */
+        inline int decodeMSBlock (const unsigned char* block, int blockBytes, int channels, const short* coefs, int coefCount, short* out) {
+            if (channels < 1 || channels > 2 || blockBytes < 7 * channels) {
+                return 0;
+            }
+            const int samples = msSamplesPerBlock(blockBytes, channels);
+
+            int coef1[2], coef2[2], delta[2], sample1[2], sample2[2];
+            for (int channel = 0; channel < channels; ++channel) {
+                const int predictorIndex = std::min((int) block[channel], coefCount - 1);
+                coef1[channel] = coefs[predictorIndex * 2];
+                coef2[channel] = coefs[predictorIndex * 2 + 1];
+                const unsigned char* p = block + channels + 2 * channel;
+                delta[channel] = (short) (p[0] | (p[1] << 8));
+                p += 2 * channels;
+                sample1[channel] = (short) (p[0] | (p[1] << 8));
+                p += 2 * channels;
+                sample2[channel] = (short) (p[0] | (p[1] << 8));
+
+                out[channel] = (short) sample2[channel];
+                out[channels + channel] = (short) sample1[channel];
+            }
+
+            /* High nibble first, channels alternate per nibble */
+            const unsigned char* nibbles = block + 7 * channels;
+            const int nibbleCount = (samples - 2) * channels;
+            for (int i = 0; i < nibbleCount; ++i) {
+                const int channel = i % channels;
+                const int nibble = (i & 1) ? (nibbles[i >> 1] & 0x0F) : (nibbles[i >> 1] >> 4);
+                const int signedNibble = (nibble & 8) ? nibble - 16 : nibble;
+
+                int predictor = (sample1[channel] * coef1[channel] + sample2[channel] * coef2[channel]) >> 8;
+                predictor += signedNibble * delta[channel];
+                predictor = std::min(std::max(predictor, -32768), 32767);
+
+                sample2[channel] = sample1[channel];
+                sample1[channel] = predictor;
+                delta[channel] = std::min(std::max((ms_adaptation_table[nibble] * delta[channel]) >> 8, 16), ms_max_delta);
+
+                out[(2 + i / channels) * channels + channel] = (short) predictor;
+            }
+            return samples;
+        }
+
+        /* Decode a whole MS ADPCM data chunk */
+        inline void decodeMS (const unsigned char* data, unsigned int dataSize, int channels, int blockAlign, const short* coefs, int coefCount, std::vector<short>* pcm) {
+            const int samples = msSamplesPerBlock(blockAlign, channels);
+            const unsigned int blockCount = dataSize / blockAlign;
+            const unsigned int tailBytes = dataSize % blockAlign;
+            pcm->resize(((size_t) blockCount * samples + (tailBytes ? samples : 0)) * channels);
+
+            short* out = pcm->data();
+            unsigned int block = 0;
+#ifdef YUNIKENGINE_SSE2
+            /* Same lanes as decodeIMA: one channel of one block per lane */
+            if (channels >= 1 && channels <= 2) {
+                const unsigned int blocksPerPass = 4 / channels;
+                for (; block + blocksPerPass <= blockCount; block += blocksPerPass) {
+                    const unsigned char* laneBlock[4];
+                    short* laneOut[4];
+                    int laneChannel[4], delta[4], sample1[4], sample2[4];
+                    short coef1[4], coef2[4];
+                    for (int lane = 0; lane < 4; ++lane) {
+                        const unsigned int laneBlockIndex = block + lane / channels;
+                        laneBlock[lane] = data + (size_t) laneBlockIndex * blockAlign;
+                        laneChannel[lane] = lane % channels;
+                        laneOut[lane] = out + (size_t) laneBlockIndex * samples * channels + laneChannel[lane];
+
+                        const unsigned char* header = laneBlock[lane];
+                        const int channel = laneChannel[lane];
+                        const int predictorIndex = std::min((int) header[channel], coefCount - 1);
+                        coef1[lane] = coefs[predictorIndex * 2];
+                        coef2[lane] = coefs[predictorIndex * 2 + 1];
+                        const unsigned char* p = header + channels + 2 * channel;
+                        delta[lane] = (short) (p[0] | (p[1] << 8));
+                        p += 2 * channels;
+                        sample1[lane] = (short) (p[0] | (p[1] << 8));
+                        p += 2 * channels;
+                        sample2[lane] = (short) (p[0] | (p[1] << 8));
+
+                        laneOut[lane][0] = (short) sample2[lane];
+                        laneOut[lane][channels] = (short) sample1[lane];
+                    }
+
+                    /* (coef1, coef2) pairs for pmaddwd */
+                    const __m128i vCoef = _mm_setr_epi16(coef1[0], coef2[0], coef1[1], coef2[1], coef1[2], coef2[2], coef1[3], coef2[3]);
+                    __m128i vDelta = _mm_setr_epi32(delta[0], delta[1], delta[2], delta[3]);
+                    __m128i vSample1 = _mm_setr_epi32(sample1[0], sample1[1], sample1[2], sample1[3]);
+                    __m128i vSample2 = _mm_setr_epi32(sample2[0], sample2[1], sample2[2], sample2[3]);
+                    const __m128i eight = _mm_set1_epi32(8);
+                    const __m128i lowHalf = _mm_set1_epi32(0xFFFF);
+                    const __m128i minDelta = _mm_set1_epi32(16);
+                    const __m128i maxDelta = _mm_set1_epi32(ms_max_delta);
+
+                    alignas(16) int lanes[4];
+                    for (int k = 2; k < samples; ++k) {
+                        const int nibble[4] = {
+                            msNibble(laneBlock[0], k, laneChannel[0], channels),
+                            msNibble(laneBlock[1], k, laneChannel[1], channels),
+                            msNibble(laneBlock[2], k, laneChannel[2], channels),
+                            msNibble(laneBlock[3], k, laneChannel[3], channels)
+                        };
+                        const __m128i vNibble = _mm_setr_epi32(nibble[0], nibble[1], nibble[2], nibble[3]);
+                        const __m128i adaptation = _mm_setr_epi32(ms_adaptation_table[nibble[0]], ms_adaptation_table[nibble[1]], ms_adaptation_table[nibble[2]], ms_adaptation_table[nibble[3]]);
+
+                        /* Samples stay in 16 bits: pair them up like the coefs */
+                        const __m128i samplePair = _mm_or_si128(_mm_and_si128(vSample1, lowHalf), _mm_slli_epi32(vSample2, 16));
+                        __m128i predictor = _mm_srai_epi32(_mm_madd_epi16(samplePair, vCoef), 8);
+
+                        /* Sign extend the nibble: (n ^ 8) - 8 */
+                        const __m128i signedNibble = _mm_sub_epi32(_mm_xor_si128(vNibble, eight), eight);
+                        predictor = _mm_add_epi32(predictor, mullo32(signedNibble, vDelta));
+
+                        /* Saturate to 16 bits and sign extend back */
+                        const __m128i packed = _mm_packs_epi32(predictor, predictor);
+                        predictor = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+
+                        vSample2 = vSample1;
+                        vSample1 = predictor;
+                        vDelta = min32(max32(_mm_srai_epi32(mullo32(adaptation, vDelta), 8), minDelta), maxDelta);
+
+                        _mm_store_si128((__m128i*) lanes, predictor);
+                        for (int lane = 0; lane < 4; ++lane) {
+                            laneOut[lane][k * channels] = (short) lanes[lane];
+                        }
+                    }
+                }
+            }
+#endif
+            for (; block < blockCount; ++block) {
+                decodeMSBlock(data + (size_t) block * blockAlign, blockAlign, channels, coefs, coefCount, out + (size_t) block * samples * channels);
+            }
+            if (tailBytes) {
+                const int tailSamples = decodeMSBlock(data + (size_t) blockCount * blockAlign, tailBytes, channels, coefs, coefCount, out + (size_t) blockCount * samples * channels);
+                pcm->resize(((size_t) blockCount * samples + tailSamples) * channels);
+            }
+        }
+    }
+}
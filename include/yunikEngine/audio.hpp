@@ -2,9 +2,12 @@
 
 #include <cstdio>
 #include <cstring>
+#include <vector>
 #include <AL/al.h>
 #include <AL/alc.h>
 #include <glm/glm.hpp>
+#include "adpcm.hpp"
+#include "stats.hpp"
 
 namespace yunikEngine {
     class Audio {
@@ -44,43 +47,43 @@ namespace yunikEngine {
 
         static void setListenerPos (glm::vec3 pos) {
             ALfloat position[] = {pos.x, pos.y, pos.z};
-            alListenerfv(AL_POSITION, position);
+            alCall(alListenerfv, AL_POSITION, position);
         }
 
         static void setListenerVel (glm::vec3 vel) {
             ALfloat velocity[] = {vel.x, vel.y, vel.z};
-            alListenerfv(AL_VELOCITY, velocity);
+            alCall(alListenerfv, AL_VELOCITY, velocity);
         }
 
         static void setListenerOri (glm::vec3 at, glm::vec3 up) {
             ALfloat ori[] = {at.x, at.y, at.z, up.x, up.y, up.z};
-            alListenerfv(AL_ORIENTATION, ori);
+            alCall(alListenerfv, AL_ORIENTATION, ori);
         }
 
         void setSourcePitch (float pitch) {
-            alSourcef(source, AL_PITCH, pitch);
+            alCall(alSourcef, source, AL_PITCH, pitch);
         }
 
         void setSourceGain (float gain) {
-            alSourcef(source, AL_GAIN, gain);
+            alCall(alSourcef, source, AL_GAIN, gain);
         }
 
         void setSourcePos (glm::vec3 pos) {
             ALfloat position[] = {pos.x, pos.y, pos.z};
-            alSourcefv(source, AL_POSITION, position);
+            alCall(alSourcefv, source, AL_POSITION, position);
         }
 
         void setSourceVel (glm::vec3 vel) {
             ALfloat velocity[] = {vel.x, vel.y, vel.z};
-            alSourcefv(source, AL_VELOCITY, velocity);
+            alCall(alSourcefv, source, AL_VELOCITY, velocity);
         }
 
         void setSourceLooping (bool isLooping) {
-            alSourcei(source, AL_LOOPING, isLooping);
+            alCall(alSourcei, source, AL_LOOPING, isLooping);
         }
 
         void setSourceRelative (bool isRelative) {
-            alSourcei(source, AL_SOURCE_RELATIVE, isRelative);
+            alCall(alSourcei, source, AL_SOURCE_RELATIVE, isRelative);
         }
 
         static Audio* create (void) {
@@ -102,11 +105,9 @@ namespace yunikEngine {
                 return false;
             }
 
-            char type[5];
+            char type[5] = {0};
             unsigned int size, chunkSize;
-            short formatType;
             unsigned int avgBytesPerSec;
-            short bytesPerSample;
 
             if (fread(type, sizeof(char), 4, fp) != 4 || strcmp(type, "RIFF") != 0) {
                 fprintf(stderr, "Error: WAV file is not RIFF\n");
@@ -117,41 +118,86 @@ namespace yunikEngine {
                 fprintf(stderr, "Error: WAV file is not WAVE\n");
                 return false;
             }
-            if (fread(type, sizeof(char), 4, fp) != 4 || strcmp(type, "fmt ") != 0) {
-                fprintf(stderr, "Error: WAV file is not fmt");
-                return false;
-            }
-            fread(&chunkSize, sizeof(unsigned int), 1, fp);
-            fread(&formatType, sizeof(short), 1, fp);
-            fread(&channels, sizeof(short), 1, fp);
-            fread(&sampleRate, sizeof(unsigned int), 1, fp);
-            fread(&avgBytesPerSec, sizeof(unsigned int), 1, fp);
-            fread(&bytesPerSample, sizeof(short), 1, fp);
-            fread(&bitsPerSample, sizeof(short), 1, fp);
-            if (fread(type, sizeof(char), 4, fp) != 4 || strcmp(type, "data") != 0) {
-                fprintf(stderr, "Error: Missing data at WAV file\n");
-                return false;
+
+            /* ADPCM files extend fmt and put a fact chunk before data */
+            bool hasFormat = false;
+            while (true) {
+                if (fread(type, sizeof(char), 4, fp) != 4 || fread(&chunkSize, sizeof(unsigned int), 1, fp) != 1) {
+                    fprintf(stderr, "Error: Missing data at WAV file\n");
+                    return false;
+                }
+                const long padding = chunkSize & 1;
+
+                if (strcmp(type, "fmt ") == 0) {
+                    fread(&formatType, sizeof(unsigned short), 1, fp);
+                    fread(&channels, sizeof(short), 1, fp);
+                    fread(&sampleRate, sizeof(unsigned int), 1, fp);
+                    fread(&avgBytesPerSec, sizeof(unsigned int), 1, fp);
+                    fread(&blockAlign, sizeof(unsigned short), 1, fp);
+                    fread(&bitsPerSample, sizeof(short), 1, fp);
+
+                    long extraSize = (long) chunkSize - 16;
+                    msCoefs.clear();
+                    if (formatType == wave_format_extensible && extraSize >= 24) {
+                        /* The SubFormat GUID starts with the format tag it
+                         * stands for */
+                        unsigned short cbSize, validBitsPerSample;
+                        unsigned int channelMask;
+                        unsigned char subFormat[16];
+                        fread(&cbSize, sizeof(unsigned short), 1, fp);
+                        fread(&validBitsPerSample, sizeof(unsigned short), 1, fp);
+                        fread(&channelMask, sizeof(unsigned int), 1, fp);
+                        fread(subFormat, sizeof(unsigned char), 16, fp);
+                        extraSize -= 24;
+                        if (memcmp(subFormat + 2, ksdataformat_guid_tail, sizeof(ksdataformat_guid_tail)) == 0) {
+                            formatType = subFormat[0] | (subFormat[1] << 8);
+                        }
+                    } else if (formatType == wave_format_ms_adpcm && extraSize >= 6) {
+                        short cbSize, samplesPerBlock, coefCount;
+                        fread(&cbSize, sizeof(short), 1, fp);
+                        fread(&samplesPerBlock, sizeof(short), 1, fp);
+                        fread(&coefCount, sizeof(short), 1, fp);
+                        extraSize -= 6;
+                        for (int i = 0; i < coefCount * 2 && extraSize >= 2; ++i, extraSize -= 2) {
+                            short coef;
+                            fread(&coef, sizeof(short), 1, fp);
+                            msCoefs.push_back(coef);
+                        }
+                    }
+                    fseek(fp, extraSize + padding, SEEK_CUR);
+                    hasFormat = true;
+                } else if (strcmp(type, "data") == 0) {
+                    if (!hasFormat) {
+                        fprintf(stderr, "Error: WAV file is not fmt\n");
+                        return false;
+                    }
+                    dataSize = chunkSize;
+                    break;
+                } else {
+                    fseek(fp, (long) chunkSize + padding, SEEK_CUR);
+                }
             }
-            fread(&dataSize, sizeof(unsigned int), 1, fp);
 
             if (buf) {
                 delete[] buf;
             }
 
             buf = new unsigned char[dataSize];
-            fread(buf, sizeof(unsigned char), dataSize, fp);
+            dataSize = fread(buf, sizeof(unsigned char), dataSize, fp);
+            Stats::add(StatCounter::BYTES_ALLOCATED, dataSize);
+            Stats::add(StatCounter::BYTES_LOADED, dataSize);
 
-            if (!bufferData()) {
-                delete[] buf;
-                return false;
-            }
+            /* OpenAL keeps its own copy */
+            const bool isBuffered = bufferData();
+            delete[] buf;
+            buf = nullptr;
 
-            return true;
+            return isBuffered;
         }
 
         bool play (void) {
-            alSourcePlay(source);
-            if (alGetError() != AL_NO_ERROR) {
+            alCall(alSourcePlay, source);
+            if (alCall(alGetError) != AL_NO_ERROR) {
                 fprintf(stderr, "OpenAL Error: Cannot play sound\n");
                 return false;
             }
@@ -159,8 +205,8 @@ namespace yunikEngine {
         }
 
         bool stop (void) {
-            alSourceStop(source);
-            if (alGetError() != AL_NO_ERROR) {
+            alCall(alSourceStop, source);
+            if (alCall(alGetError) != AL_NO_ERROR) {
                 fprintf(stderr, "OpenAL Error: Cannot stop sound\n");
                 return false;
             }
@@ -170,9 +216,9 @@ namespace yunikEngine {
         /**************************** PRIVATE *********************************/
         private:
         Audio (void) {
-            alGenBuffers(1, &buffer);
-            alGenSources(1, &source);
-            if (alGetError() != AL_NO_ERROR) {
+            alCall(alGenBuffers, 1, &buffer);
+            alCall(alGenSources, 1, &source);
+            if (alCall(alGetError) != AL_NO_ERROR) {
                 fprintf(stderr, "OpenAL Error: Cannot generate source\n");
                 return;
             }
@@ -182,23 +228,46 @@ namespace yunikEngine {
 
         ~Audio (void) {
             if (source) {
-                alDeleteSources(1, &source);
+                alCall(alDeleteSources, 1, &source);
             }
             if (buffer) {
-                alDeleteBuffers(1, &buffer);
+                alCall(alDeleteBuffers, 1, &buffer);
             }
             delete[] buf;
         }
 
         bool bufferData (void) {
+            bool isBuffered = false;
+            if (formatType == wave_format_pcm) {
+                isBuffered = bufferPCM(buf, dataSize, bitsPerSample);
+            } else if (formatType == wave_format_ima_adpcm) {
+                isBuffered = bufferIMA();
+            } else if (formatType == wave_format_ms_adpcm) {
+                isBuffered = bufferMS();
+            } else {
+                fprintf(stderr, "Error: Unsupported format %u at WAV file\n", formatType);
+            }
+            if (!isBuffered) {
+                return false;
+            }
+
+            alCall(alSourcei, source, AL_BUFFER, buffer);
+            setSourceRelative(true);
+            setSourcePos(glm::vec3(0.0, 0.0, 0.0));
+            setSourceVel(glm::vec3(0.0, 0.0, 0.0));
+
+            return true;
+        }
+
+        bool bufferPCM (const void* data, unsigned int size, short bits) {
             ALenum format = 0;
-            if (bitsPerSample == 8) {
+            if (bits == 8) {
                 if (channels == 1) {
                     format = AL_FORMAT_MONO8;
                 } else if (channels == 2) {
                     format = AL_FORMAT_STEREO8;
                 }
-            } else if (bitsPerSample == 16) {
+            } else if (bits == 16) {
                 if (channels == 1) {
                     format = AL_FORMAT_MONO16;
                 } else if (channels == 2) {
@@ -211,20 +280,79 @@ namespace yunikEngine {
                 return false;
             }
 
-            alBufferData(buffer, format, buf, dataSize, sampleRate);
-            if (alGetError() != AL_NO_ERROR) {
+            alCall(alBufferData, buffer, format, data, size, sampleRate);
+            if (alCall(alGetError) != AL_NO_ERROR) {
                 fprintf(stderr, "OpenAL Error: Error loading ALBuffer\n");
                 return false;
             }
 
-            alSourcei(source, AL_BUFFER, buffer);
-            setSourceRelative(true);
-            setSourcePos(glm::vec3(0.0, 0.0, 0.0));
-            setSourceVel(glm::vec3(0.0, 0.0, 0.0));
-
             return true;
         }
 
+        /* Upload IMA ADPCM as is through AL_EXT_IMA4, else decode it */
+        bool bufferIMA (void) {
+            if (channels < 1 || blockAlign <= 4 * channels) {
+                fprintf(stderr, "Error: Wrong BlockAlign at WAV file\n");
+                return false;
+            }
+            if (bufferNativeADPCM("AL_EXT_IMA4", "AL_FORMAT_MONO_IMA4", "AL_FORMAT_STEREO_IMA4", adpcm::imaSamplesPerBlock(blockAlign, channels))) {
+                return true;
+            }
+
+            std::vector<short> pcm;
+            adpcm::decodeIMA(buf, dataSize, channels, blockAlign, &pcm);
+            Stats::add(StatCounter::BYTES_ALLOCATED, pcm.size() * sizeof(short));
+            return bufferPCM(pcm.data(), pcm.size() * sizeof(short), 16);
+        }
+
+        /* OpenAL only knows the standard coefficient set: anything else is
+         * decoded */
+        bool bufferMS (void) {
+            if (channels < 1 || channels > 2 || blockAlign <= 7 * channels) {
+                fprintf(stderr, "Error: Wrong BlockAlign at WAV file\n");
+                return false;
+            }
+            const bool isStandard = msCoefs.size() >= 14 && memcmp(msCoefs.data(), adpcm::ms_standard_coefs, sizeof(adpcm::ms_standard_coefs)) == 0;
+            if (isStandard && bufferNativeADPCM("AL_SOFT_MSADPCM", "AL_FORMAT_MONO_MSADPCM_SOFT", "AL_FORMAT_STEREO_MSADPCM_SOFT", adpcm::msSamplesPerBlock(blockAlign, channels))) {
+                return true;
+            }
+
+            const short* coefs = msCoefs.size() >= 2 ? msCoefs.data() : adpcm::ms_standard_coefs;
+            const int coefCount = msCoefs.size() >= 2 ? (int) msCoefs.size() / 2 : 7;
+            std::vector<short> pcm;
+            adpcm::decodeMS(buf, dataSize, channels, blockAlign, coefs, coefCount, &pcm);
+            Stats::add(StatCounter::BYTES_ALLOCATED, pcm.size() * sizeof(short));
+            return bufferPCM(pcm.data(), pcm.size() * sizeof(short), 16);
+        }
+
+        /* Needs AL_SOFT_block_alignment to pass the file's block size. Only
+         * whole blocks are uploaded. */
+        bool bufferNativeADPCM (const char* extension, const char* monoFormat, const char* stereoFormat, int samplesPerBlock) {
+            if (channels < 1 || channels > 2 || !alCall(alIsExtensionPresent, extension) || !alCall(alIsExtensionPresent, "AL_SOFT_block_alignment")) {
+                return false;
+            }
+            const ALenum format = alCall(alGetEnumValue, channels == 1 ? monoFormat : stereoFormat);
+            const ALenum unpackBlockAlignment = alCall(alGetEnumValue, "AL_UNPACK_BLOCK_ALIGNMENT_SOFT");
+            const unsigned int blockBytes = dataSize / blockAlign * blockAlign;
+            if (!format || !unpackBlockAlignment || blockBytes == 0) {
+                return false;
+            }
+
+            alCall(alGetError);
+            alCall(alBufferi, buffer, unpackBlockAlignment, samplesPerBlock);
+            alCall(alBufferData, buffer, format, buf, blockBytes, sampleRate);
+            const bool isBuffered = alCall(alGetError) == AL_NO_ERROR;
+            alCall(alBufferi, buffer, unpackBlockAlignment, 0);
+            return isBuffered;
+        }
+
+        /* Make an AL call and count it */
+        template <typename Function, typename... Args>
+        static auto alCall (Function function, Args... args) -> decltype(function(args...)) {
+            Stats::add(StatCounter::AL_CALLS);
+            return function(args...);
+        }
+
         bool isValid = false;
 
         static ALCdevice* device;
@@ -233,9 +361,19 @@ namespace yunikEngine {
         ALuint source;
         ALuint buffer;
 
+        static const unsigned short wave_format_pcm = 0x0001;
+        static const unsigned short wave_format_ms_adpcm = 0x0002;
+        static const unsigned short wave_format_ima_adpcm = 0x0011;
+        static const unsigned short wave_format_extensible = 0xFFFE;
+        /* KSDATAFORMAT_SUBTYPE_* GUIDs after their 16-bit format tag */
+        static const unsigned char ksdataformat_guid_tail[14];
+
+        unsigned short formatType;
         short channels;
         unsigned int sampleRate;
+        unsigned short blockAlign;
         short bitsPerSample;
+        std::vector<short> msCoefs;
         unsigned int dataSize;
         unsigned char* buf = nullptr;
     };
@@ -243,4 +381,7 @@ namespace yunikEngine {
     /************************** INITIALIZATION ********************************/
     ALCdevice* Audio::device = nullptr;
     ALCcontext* Audio::context = nullptr;
+    const unsigned char Audio::ksdataformat_guid_tail[14] = {
+        0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+    };
 }
@@ -56,6 +56,19 @@ namespace yunikEngine {
             return projMatrix;
         }
 
+        float getFov (void) {
+            return aFov;
+        }
+
+        void getDepth (float* zNear, float* zFar) {
+            *zNear = aZNear;
+            *zFar = aZFar;
+        }
+
+        bool getOrtho (void) {
+            return isOrthographic;
+        }
+
         /**************************** PRIVATE *********************************/
         private:
         Camera (bool isOrtho, float width, float height) {
@@ -0,0 +1,394 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "camera.hpp"
+#include "shader.hpp"
+#include "workerPool.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define YUNIKENGINE_SSE2
+#endif
+
+namespace yunikEngine {
+    /**************************************************************************/
+    /*                               LightType                                */
+    /**************************************************************************/
+    enum class LightType : int {
+        POINT = 0,
+        SPOT = 1
+    };
+
+    /**************************************************************************/
+    /*                                 Light                                  */
+    /**************************************************************************/
+    struct Light {
+        LightType type = LightType::POINT;
+        glm::vec3 position = glm::vec3(0.0, 0.0, 0.0);
+        glm::vec3 direction = glm::vec3(0.0, 0.0, -1.0);
+        glm::vec3 color = glm::vec3(1.0, 1.0, 1.0);
+        float intensity = 1.0f;
+        float radius = 1.0f;
+
+        /* Outer cone half angle in degrees, SPOT only */
+        float spotAngle = 30.0f;
+    };
+
+    /**************************************************************************/
+    /*                           ClusteredLighting                            */
+    /**************************************************************************/
+    /* Splits the camera frustum into screen tiles x depth slices and assigns
+     * lights to the clusters they touch on the CPU. The result is uploaded as
+     * three texture buffers read by example::clusteredFragmentShader:
+     *   uLights       : 3 RGBA32F texels per light (view space)
+     *   uClusterGrid  : RG32UI (offset, count) per cluster
+     *   uLightIndices : R16UI light index lists */
+    class ClusteredLighting {
+        /***************************** PUBLIC *********************************/
+        public:
+        static ClusteredLighting* create (int clusterX, int clusterY, int clusterZ) {
+            auto newClusteredLighting = new ClusteredLighting(clusterX, clusterY, clusterZ);
+            if (!newClusteredLighting->isValid) {
+                newClusteredLighting->destroy();
+                return nullptr;
+            }
+            return newClusteredLighting;
+        }
+
+        void destroy (void) {
+            delete this;
+        }
+
+        /* Threads used by cull, the calling one included. 0 means hardware
+         * concurrency */
+        void setThreadCount (int count) {
+            workerPool->destroy();
+            workerPool = WorkerPool::create(count);
+        }
+
+        void setAmbient (glm::vec3 ambient) {
+            ambientColor = ambient;
+        }
+
+        /* Assign lights to clusters of the camera's frustum */
+        void cull (Camera* camera, const std::vector<Light>& lights) {
+            const size_t lightNum = std::min(lights.size(), (size_t) max_light_num);
+            if (lights.size() > (size_t) max_light_num) {
+                fprintf(stderr, "Error: Too many lights for clustered lighting, %d used\n", max_light_num);
+            }
+
+            setupSlices(camera);
+            transformLights(camera->getViewMatrix(), lights, lightNum);
+
+            const int workers = std::max(1, std::min(workerPool->getThreadCount(), clusterCountZ));
+            if ((int) workerIndices.size() < workers) {
+                workerIndices.resize(workers);
+            }
+            workerPool->run(workers, [this, workers] (int i) {
+                const int sliceBegin = clusterCountZ * i / workers;
+                const int sliceEnd = clusterCountZ * (i + 1) / workers;
+                workerIndices[i].clear();
+                cullSlices(sliceBegin, sliceEnd, &workerIndices[i]);
+            });
+
+            /* Workers wrote offsets relative to their own lists */
+            lightIndices.clear();
+            for (int i = 0; i < workers; ++i) {
+                const uint32_t base = (uint32_t) lightIndices.size();
+                const int sliceBegin = clusterCountZ * i / workers;
+                const int sliceEnd = clusterCountZ * (i + 1) / workers;
+                for (int cluster = sliceBegin * clusterCountX * clusterCountY; cluster < sliceEnd * clusterCountX * clusterCountY; ++cluster) {
+                    clusterGrid[cluster * 2] += base;
+                }
+                lightIndices.insert(lightIndices.end(), workerIndices[i].begin(), workerIndices[i].end());
+            }
+        }
+
+        /* Upload the result of the last cull */
+        void upload (void) {
+            glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer);
+            glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(lightData.size(), 1) * sizeof(glm::vec4), lightData.data(), GL_STREAM_DRAW);
+            glBindBuffer(GL_TEXTURE_BUFFER, gridBuffer);
+            glBufferData(GL_TEXTURE_BUFFER, clusterGrid.size() * sizeof(uint32_t), clusterGrid.data(), GL_STREAM_DRAW);
+            glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+            glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(lightIndices.size(), 1) * sizeof(uint16_t), lightIndices.data(), GL_STREAM_DRAW);
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        }
+
+        /* Bind the buffers to textureUnit .. textureUnit + 2 and set the
+         * uniforms of a program built on example::clusteredFragmentShader.
+         * The current GL viewport is used for the screen tiles. */
+        void bind (ShaderProgram* program, int textureUnit) {
+            GLint viewport[4];
+            glGetIntegerv(GL_VIEWPORT, viewport);
+
+            glActiveTexture(GL_TEXTURE0 + textureUnit);
+            glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, lightBuffer);
+            glActiveTexture(GL_TEXTURE0 + textureUnit + 1);
+            glBindTexture(GL_TEXTURE_BUFFER, gridTexture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, gridBuffer);
+            glActiveTexture(GL_TEXTURE0 + textureUnit + 2);
+            glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_R16UI, indexBuffer);
+            glActiveTexture(GL_TEXTURE0);
+
+            program->use();
+            program->setInt("uLights", textureUnit);
+            program->setInt("uClusterGrid", textureUnit + 1);
+            program->setInt("uLightIndices", textureUnit + 2);
+            program->setVec3("uClusterDims", glm::vec3(clusterCountX, clusterCountY, clusterCountZ));
+            program->setVec4("uViewport", glm::vec4(viewport[0], viewport[1], viewport[2], viewport[3]));
+            program->setVec3("uSliceParams", glm::vec3(sliceScale, sliceBias, isLogSlices ? 1.0f : 0.0f));
+            program->setVec3("uAmbient", ambientColor);
+        }
+
+        /* Total light references of the last cull */
+        size_t getLightIndexCount (void) {
+            return lightIndices.size();
+        }
+
+        /**************************** PRIVATE *********************************/
+        private:
+        ClusteredLighting (int clusterX, int clusterY, int clusterZ) {
+            if (clusterX <= 0 || clusterY <= 0 || clusterZ <= 0) {
+                fprintf(stderr, "Error: Wrong cluster dimensions\n");
+                return;
+            }
+            clusterCountX = clusterX;
+            clusterCountY = clusterY;
+            clusterCountZ = clusterZ;
+            clusterGrid.resize(clusterX * clusterY * clusterZ * 2, 0);
+
+            workerPool = WorkerPool::create(0);
+
+            glGenBuffers(1, &lightBuffer);
+            glGenBuffers(1, &gridBuffer);
+            glGenBuffers(1, &indexBuffer);
+            glGenTextures(1, &lightTexture);
+            glGenTextures(1, &gridTexture);
+            glGenTextures(1, &indexTexture);
+
+            isValid = true;
+        }
+
+        ~ClusteredLighting (void) {
+            glDeleteTextures(1, &indexTexture);
+            glDeleteTextures(1, &gridTexture);
+            glDeleteTextures(1, &lightTexture);
+            glDeleteBuffers(1, &indexBuffer);
+            glDeleteBuffers(1, &gridBuffer);
+            glDeleteBuffers(1, &lightBuffer);
+            if (workerPool != nullptr) {
+                workerPool->destroy();
+            }
+        }
+
+        /* Perspective cameras get exponential slices, orthographic ones linear.
+         * Slice of a view depth d: f(d) * sliceScale - sliceBias, where f is
+         * log for exponential slices */
+        void setupSlices (Camera* camera) {
+            float zNear, zFar;
+            camera->getDepth(&zNear, &zFar);
+            const glm::mat4 proj = camera->getProjMatrix();
+
+            isLogSlices = !camera->getOrtho();
+            projScaleX = proj[0][0];
+            projScaleY = proj[1][1];
+            projOffsetX = proj[3][0];
+            projOffsetY = proj[3][1];
+
+            sliceDepths.resize(clusterCountZ + 1);
+            if (isLogSlices) {
+                const float logRatio = std::log(zFar / zNear);
+                sliceScale = clusterCountZ / logRatio;
+                sliceBias = clusterCountZ * std::log(zNear) / logRatio;
+                for (int z = 0; z <= clusterCountZ; ++z) {
+                    sliceDepths[z] = zNear * std::pow(zFar / zNear, (float) z / clusterCountZ);
+                }
+            } else {
+                sliceScale = clusterCountZ / (zFar - zNear);
+                sliceBias = clusterCountZ * zNear / (zFar - zNear);
+                for (int z = 0; z <= clusterCountZ; ++z) {
+                    sliceDepths[z] = zNear + (zFar - zNear) * z / clusterCountZ;
+                }
+            }
+        }
+
+        void transformLights (const glm::mat4& viewMatrix, const std::vector<Light>& lights, size_t lightNum) {
+            /* Pad to a multiple of 4 with lights that never intersect */
+            const size_t paddedNum = (lightNum + 3) & ~(size_t) 3;
+            lightX.assign(paddedNum, 0.0f);
+            lightY.assign(paddedNum, 0.0f);
+            lightZ.assign(paddedNum, 0.0f);
+            lightRadius.assign(paddedNum, -1.0f);
+            lightData.resize(lightNum * 3);
+
+            for (size_t i = 0; i < lightNum; ++i) {
+                const Light& light = lights[i];
+                const glm::vec4 pos = viewMatrix * glm::vec4(light.position, 1.0);
+                const glm::vec4 dir = viewMatrix * glm::vec4(light.direction, 0.0);
+                const glm::vec3 color = light.color * light.intensity;
+
+                lightX[i] = pos.x;
+                lightY[i] = pos.y;
+                lightZ[i] = pos.z;
+                lightRadius[i] = light.radius;
+
+                lightData[i * 3] = glm::vec4(pos.x, pos.y, pos.z, light.radius);
+                lightData[i * 3 + 1] = glm::vec4(color, (float) static_cast<int>(light.type));
+                lightData[i * 3 + 2] = glm::vec4(glm::normalize(glm::vec3(dir.x, dir.y, dir.z)), std::cos(glm::radians(light.spotAngle)));
+            }
+        }
+
+        /* View space x (or y) of an NDC coordinate at view depth d */
+        float unprojectX (float ndc, float d) {
+            return isLogSlices ? ndc * d / projScaleX : (ndc - projOffsetX) / projScaleX;
+        }
+
+        float unprojectY (float ndc, float d) {
+            return isLogSlices ? ndc * d / projScaleY : (ndc - projOffsetY) / projScaleY;
+        }
+
+        void cullSlices (int sliceBegin, int sliceEnd, std::vector<uint16_t>* indices) {
+            std::vector<uint16_t> candidates;
+            std::vector<float> candidateX, candidateY, candidateZ, candidateRadius2;
+
+            for (int z = sliceBegin; z < sliceEnd; ++z) {
+                const float d0 = sliceDepths[z];
+                const float d1 = sliceDepths[z + 1];
+
+                /* Lights overlapping the slice depth range (view z is -d) */
+                candidates.clear();
+                candidateX.clear();
+                candidateY.clear();
+                candidateZ.clear();
+                candidateRadius2.clear();
+                for (size_t i = 0; i < lightData.size() / 3; ++i) {
+                    if (lightZ[i] - lightRadius[i] <= -d0 && lightZ[i] + lightRadius[i] >= -d1) {
+                        candidates.push_back((uint16_t) i);
+                        candidateX.push_back(lightX[i]);
+                        candidateY.push_back(lightY[i]);
+                        candidateZ.push_back(lightZ[i]);
+                        candidateRadius2.push_back(lightRadius[i] * lightRadius[i]);
+                    }
+                }
+                while (candidateX.size() & 3) {
+                    candidateX.push_back(0.0f);
+                    candidateY.push_back(0.0f);
+                    candidateZ.push_back(0.0f);
+                    candidateRadius2.push_back(-1.0f);
+                }
+
+                for (int y = 0; y < clusterCountY; ++y) {
+                    const float ndcY0 = -1.0f + 2.0f * y / clusterCountY;
+                    const float ndcY1 = -1.0f + 2.0f * (y + 1) / clusterCountY;
+                    const float minY = std::min(std::min(unprojectY(ndcY0, d0), unprojectY(ndcY0, d1)), std::min(unprojectY(ndcY1, d0), unprojectY(ndcY1, d1)));
+                    const float maxY = std::max(std::max(unprojectY(ndcY0, d0), unprojectY(ndcY0, d1)), std::max(unprojectY(ndcY1, d0), unprojectY(ndcY1, d1)));
+
+                    for (int x = 0; x < clusterCountX; ++x) {
+                        const float ndcX0 = -1.0f + 2.0f * x / clusterCountX;
+                        const float ndcX1 = -1.0f + 2.0f * (x + 1) / clusterCountX;
+                        const float minX = std::min(std::min(unprojectX(ndcX0, d0), unprojectX(ndcX0, d1)), std::min(unprojectX(ndcX1, d0), unprojectX(ndcX1, d1)));
+                        const float maxX = std::max(std::max(unprojectX(ndcX0, d0), unprojectX(ndcX0, d1)), std::max(unprojectX(ndcX1, d0), unprojectX(ndcX1, d1)));
+
+                        const int cluster = (z * clusterCountY + y) * clusterCountX + x;
+                        clusterGrid[cluster * 2] = (uint32_t) indices->size();
+
+                        const glm::vec3 boxMin(minX, minY, -d1);
+                        const glm::vec3 boxMax(maxX, maxY, -d0);
+                        for (size_t i = 0; i < candidateX.size(); i += 4) {
+                            int mask = testSpheres(&candidateX[i], &candidateY[i], &candidateZ[i], &candidateRadius2[i], boxMin, boxMax);
+                            while (mask) {
+                                const int lane = lowestBit(mask);
+                                indices->push_back(candidates[i + lane]);
+                                mask &= mask - 1;
+                            }
+                        }
+                        clusterGrid[cluster * 2 + 1] = (uint32_t) indices->size() - clusterGrid[cluster * 2];
+                    }
+                }
+            }
+        }
+
+        static int lowestBit (int mask) {
+            int bit = 0;
+            while (!(mask & (1 << bit))) {
+                ++bit;
+            }
+            return bit;
+        }
+
+        /* Sphere / AABB overlap of 4 lights at once. Bit i set if light i hits */
+        static int testSpheres (const float* x, const float* y, const float* z, const float* radius2, glm::vec3 boxMin, glm::vec3 boxMax) {
+#ifdef YUNIKENGINE_SSE2
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 px = _mm_loadu_ps(x);
+            const __m128 py = _mm_loadu_ps(y);
+            const __m128 pz = _mm_loadu_ps(z);
+            const __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(boxMin.x), px), zero), _mm_max_ps(_mm_sub_ps(px, _mm_set1_ps(boxMax.x)), zero));
+            const __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(boxMin.y), py), zero), _mm_max_ps(_mm_sub_ps(py, _mm_set1_ps(boxMax.y)), zero));
+            const __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(boxMin.z), pz), zero), _mm_max_ps(_mm_sub_ps(pz, _mm_set1_ps(boxMax.z)), zero));
+            const __m128 dist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            return _mm_movemask_ps(_mm_cmple_ps(dist2, _mm_loadu_ps(radius2)));
+#else
+            int mask = 0;
+            for (int i = 0; i < 4; ++i) {
+                const float dx = std::max(boxMin.x - x[i], 0.0f) + std::max(x[i] - boxMax.x, 0.0f);
+                const float dy = std::max(boxMin.y - y[i], 0.0f) + std::max(y[i] - boxMax.y, 0.0f);
+                const float dz = std::max(boxMin.z - z[i], 0.0f) + std::max(z[i] - boxMax.z, 0.0f);
+                if (dx * dx + dy * dy + dz * dz <= radius2[i]) {
+                    mask |= 1 << i;
+                }
+            }
+            return mask;
+#endif
+        }
+
+        /* Light indices are stored as 16 bits */
+        static const int max_light_num = 65535;
+
+        int clusterCountX;
+        int clusterCountY;
+        int clusterCountZ;
+
+        WorkerPool* workerPool = nullptr;
+        std::vector<std::vector<uint16_t>> workerIndices;
+
+        bool isLogSlices = true;
+        float sliceScale = 1.0f;
+        float sliceBias = 0.0f;
+        float projScaleX = 1.0f;
+        float projScaleY = 1.0f;
+        float projOffsetX = 0.0f;
+        float projOffsetY = 0.0f;
+        std::vector<float> sliceDepths;
+
+        /* View space lights, structure of arrays padded to 4 */
+        std::vector<float> lightX;
+        std::vector<float> lightY;
+        std::vector<float> lightZ;
+        std::vector<float> lightRadius;
+
+        std::vector<glm::vec4> lightData;
+        std::vector<uint32_t> clusterGrid;
+        std::vector<uint16_t> lightIndices;
+
+        glm::vec3 ambientColor = glm::vec3(0.1, 0.1, 0.1);
+
+        GLuint lightBuffer = 0;
+        GLuint gridBuffer = 0;
+        GLuint indexBuffer = 0;
+        GLuint lightTexture = 0;
+        GLuint gridTexture = 0;
+        GLuint indexTexture = 0;
+
+        bool isValid = false;
+    };
+}
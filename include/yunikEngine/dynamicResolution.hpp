@@ -0,0 +1,293 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <GL/glew.h>
+
+namespace yunikEngine {
+    /**************************************************************************/
+    /*                             UpscaleFilter                              */
+    /**************************************************************************/
+    enum class UpscaleFilter : GLenum {
+        NEAREST = GL_NEAREST,
+        LINEAR = GL_LINEAR
+    };
+
+    /**************************************************************************/
+    /*                           DynamicResolution                            */
+    /**************************************************************************/
+    /* Renders the scene into an offscreen framebuffer whose resolution follows
+     * the measured GPU time, then upscales it into the window viewport. The
+     * window's default framebuffer must be single-sampled
+     * (Window::setSamples(0)): multisampling is done in the offscreen
+     * framebuffer instead. */
+    class DynamicResolution {
+        /***************************** PUBLIC *********************************/
+        public:
+        static DynamicResolution* create (int samples, UpscaleFilter filter) {
+            auto newDynamicResolution = new DynamicResolution(samples, static_cast<GLenum>(filter));
+            if (!newDynamicResolution->isValid) {
+                newDynamicResolution->destroy();
+                return nullptr;
+            }
+            return newDynamicResolution;
+        }
+
+        void destroy (void) {
+            delete this;
+        }
+
+        void setFilter (UpscaleFilter filter) {
+            upscaleFilter = static_cast<GLenum>(filter);
+        }
+
+        /* GPU frame budget in milliseconds */
+        void setTargetFrameTime (double ms) {
+            targetFrameTime = ms;
+        }
+
+        void setScaleRange (float minScale, float maxScale) {
+            scaleMin = minScale;
+            scaleMax = maxScale;
+            scale = std::min(std::max(scale, scaleMin), scaleMax);
+        }
+
+        float getScale (void) {
+            return scale;
+        }
+
+        /* Last measured GPU time in milliseconds */
+        double getGPUFrameTime (void) {
+            return gpuFrameTime;
+        }
+
+        /* Bind the offscreen framebuffer sized for the given window viewport */
+        void begin (const GLint viewport[4]) {
+            collectQueries();
+
+            for (int i = 0; i < 4; ++i) {
+                targetViewport[i] = viewport[i];
+            }
+            if (viewport[2] > bufferWidth || viewport[3] > bufferHeight) {
+                if (!allocateBuffers(viewport[2], viewport[3])) {
+                    return;
+                }
+            }
+
+            renderWidth = std::max(1, (int) std::lround(viewport[2] * scale));
+            renderHeight = std::max(1, (int) std::lround(viewport[3] * scale));
+
+            /* The scissor keeps the window's clear to the rendered region
+             * instead of the whole full-size buffer. end() disables it. */
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glViewport(0, 0, renderWidth, renderHeight);
+            glScissor(0, 0, renderWidth, renderHeight);
+            glEnable(GL_SCISSOR_TEST);
+            isFrameActive = true;
+
+            if (queryCount < query_num) {
+                queryScales[queryHead] = scale;
+                glBeginQuery(GL_TIME_ELAPSED, queries[queryHead]);
+                isQueryActive = true;
+            }
+        }
+
+        /* Upscale the rendered region into the window viewport */
+        void end (void) {
+            if (!isFrameActive) {
+                return;
+            }
+            isFrameActive = false;
+
+            if (isQueryActive) {
+                glEndQuery(GL_TIME_ELAPSED);
+                queryHead = (queryHead + 1) % query_num;
+                ++queryCount;
+                isQueryActive = false;
+            }
+
+            if (samples > 0) {
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFramebuffer);
+                glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, renderWidth, renderHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, resolveFramebuffer);
+            } else {
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+            }
+
+            /* Clear the letterbox bars */
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glDisable(GL_SCISSOR_TEST);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            glBlitFramebuffer(0, 0, renderWidth, renderHeight,
+                targetViewport[0], targetViewport[1], targetViewport[0] + targetViewport[2], targetViewport[1] + targetViewport[3],
+                GL_COLOR_BUFFER_BIT, upscaleFilter);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(targetViewport[0], targetViewport[1], targetViewport[2], targetViewport[3]);
+        }
+
+        /**************************** PRIVATE *********************************/
+        private:
+        DynamicResolution (int samples, GLenum filter) {
+            GLint defaultSampleBuffers = 0;
+            glGetIntegerv(GL_SAMPLE_BUFFERS, &defaultSampleBuffers);
+            if (defaultSampleBuffers > 0) {
+                fprintf(stderr, "Error: Dynamic resolution needs a single-sampled window\n");
+                return;
+            }
+
+            this->samples = samples;
+            upscaleFilter = filter;
+
+            glGenFramebuffers(1, &framebuffer);
+            glGenRenderbuffers(1, &colorBuffer);
+            glGenRenderbuffers(1, &depthBuffer);
+            if (samples > 0) {
+                glGenFramebuffers(1, &resolveFramebuffer);
+                glGenRenderbuffers(1, &resolveColorBuffer);
+            }
+            glGenQueries(query_num, queries);
+
+            isValid = true;
+        }
+
+        ~DynamicResolution (void) {
+            glDeleteQueries(query_num, queries);
+            glDeleteRenderbuffers(1, &resolveColorBuffer);
+            glDeleteFramebuffers(1, &resolveFramebuffer);
+            glDeleteRenderbuffers(1, &depthBuffer);
+            glDeleteRenderbuffers(1, &colorBuffer);
+            glDeleteFramebuffers(1, &framebuffer);
+        }
+
+        /* Buffers are allocated at full viewport size and only a sub-region
+         * is rendered, so scale changes never reallocate */
+        bool allocateBuffers (GLsizei width, GLsizei height) {
+            glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+            glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH24_STENCIL8, width, height);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+            bool isComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+            if (isComplete && samples > 0) {
+                glBindRenderbuffer(GL_RENDERBUFFER, resolveColorBuffer);
+                glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+                glBindFramebuffer(GL_FRAMEBUFFER, resolveFramebuffer);
+                glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, resolveColorBuffer);
+                isComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+            }
+
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            if (!isComplete) {
+                fprintf(stderr, "OpenGL Error: Dynamic resolution framebuffer is incomplete\n");
+                bufferWidth = 0;
+                bufferHeight = 0;
+                return false;
+            }
+
+            bufferWidth = width;
+            bufferHeight = height;
+            return true;
+        }
+
+        /* Read finished timer queries without stalling the pipeline */
+        void collectQueries (void) {
+            while (queryCount > 0) {
+                const int tail = (queryHead + query_num - queryCount) % query_num;
+                GLint isAvailable = 0;
+                glGetQueryObjectiv(queries[tail], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+                if (!isAvailable) {
+                    return;
+                }
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(queries[tail], GL_QUERY_RESULT, &elapsed);
+                --queryCount;
+
+                /* Frames rendered before the last scale change would
+                 * trigger it again */
+                if (queryScales[tail] != scale) {
+                    continue;
+                }
+                gpuFrameTime = elapsed / 1000000.0;
+                updateScale();
+            }
+        }
+
+        /* Hysteresis controller: drop quickly when over budget, climb slowly
+         * when comfortably under it, hold in between */
+        void updateScale (void) {
+            if (gpuFrameTime > targetFrameTime * over_budget_ratio) {
+                ++overBudgetFrames;
+                underBudgetFrames = 0;
+            } else if (gpuFrameTime < targetFrameTime * under_budget_ratio) {
+                ++underBudgetFrames;
+                overBudgetFrames = 0;
+            } else {
+                overBudgetFrames = 0;
+                underBudgetFrames = 0;
+            }
+
+            if (overBudgetFrames >= over_budget_frames) {
+                /* GPU time is roughly proportional to the pixel count */
+                const float ratio = (float) std::sqrt(targetFrameTime * under_budget_ratio / gpuFrameTime);
+                scale *= std::max(ratio, 1.0f - max_scale_down_step);
+                overBudgetFrames = 0;
+            } else if (underBudgetFrames >= under_budget_frames) {
+                scale += scale_up_step;
+                underBudgetFrames = 0;
+            }
+            scale = std::min(std::max(scale, scaleMin), scaleMax);
+        }
+
+        static const int query_num = 4;
+
+        static constexpr double over_budget_ratio = 0.95;
+        static constexpr double under_budget_ratio = 0.8;
+        static const int over_budget_frames = 2;
+        static const int under_budget_frames = 30;
+        static constexpr float max_scale_down_step = 0.25f;
+        static constexpr float scale_up_step = 0.05f;
+
+        GLuint framebuffer = 0;
+        GLuint colorBuffer = 0;
+        GLuint depthBuffer = 0;
+        GLuint resolveFramebuffer = 0;
+        GLuint resolveColorBuffer = 0;
+        GLsizei bufferWidth = 0;
+        GLsizei bufferHeight = 0;
+        GLsizei renderWidth = 0;
+        GLsizei renderHeight = 0;
+        GLint targetViewport[4] = {0, 0, 0, 0};
+        bool isFrameActive = false;
+
+        int samples = 0;
+        GLenum upscaleFilter = GL_LINEAR;
+
+        GLuint queries[query_num] = {0, 0, 0, 0};
+        float queryScales[query_num] = {0.0f, 0.0f, 0.0f, 0.0f};
+        int queryHead = 0;
+        int queryCount = 0;
+        bool isQueryActive = false;
+
+        double targetFrameTime = 1000.0 / 60.0;
+        double gpuFrameTime = 0.0;
+        int overBudgetFrames = 0;
+        int underBudgetFrames = 0;
+
+        float scale = 1.0f;
+        float scaleMin = 0.5f;
+        float scaleMax = 1.0f;
+
+        bool isValid = false;
+    };
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace yunikEngine {
+    /**************************************************************************/
+    /*                             InputEventType                             */
+    /**************************************************************************/
+    enum class InputEventType : int {
+        KEY,
+        CHAR,
+        MOUSE_BUTTON,
+        CURSOR_POS,
+        SCROLL
+    };
+
+    /**************************************************************************/
+    /*                               InputEvent                               */
+    /**************************************************************************/
+    struct InputEvent {
+        InputEventType type;
+
+        /* KEY: key, scancode, action, mods / CHAR: codepoint in code /
+         * MOUSE_BUTTON: button in code, action, mods */
+        int code;
+        int scancode;
+        int action;
+        int mods;
+
+        /* CURSOR_POS: cursor position / SCROLL: scroll offset */
+        double x;
+        double y;
+
+        /* glfwGetTime() when the event was polled */
+        double timestamp;
+    };
+
+    /**************************************************************************/
+    /*                               InputQueue                               */
+    /**************************************************************************/
+    /* Lock-free single producer / single consumer ring buffer. The producer is
+     * the thread polling GLFW, the consumer is the thread running
+     * Scene::update. */
+    class InputQueue {
+        /***************************** PUBLIC *********************************/
+        public:
+        bool push (const InputEvent& event) {
+            const size_t tail = tailIndex.load(std::memory_order_relaxed);
+            const size_t next = (tail + 1) & (capacity - 1);
+            if (next == headIndex.load(std::memory_order_acquire)) {
+                /* Full: drop the newest event rather than block the poller */
+                return false;
+            }
+            events[tail] = event;
+            tailIndex.store(next, std::memory_order_release);
+            return true;
+        }
+
+        bool pop (InputEvent* event) {
+            const size_t head = headIndex.load(std::memory_order_relaxed);
+            if (head == tailIndex.load(std::memory_order_acquire)) {
+                return false;
+            }
+            *event = events[head];
+            headIndex.store((head + 1) & (capacity - 1), std::memory_order_release);
+            return true;
+        }
+
+        bool isEmpty (void) {
+            return headIndex.load(std::memory_order_acquire) == tailIndex.load(std::memory_order_acquire);
+        }
+
+        /**************************** PRIVATE *********************************/
+        private:
+        /* Must be a power of two */
+        static const size_t capacity = 1024;
+
+        InputEvent events[capacity];
+
+        /* Keep the two indices on separate cache lines */
+        std::atomic<size_t> headIndex {0};
+        char padding[64];
+        std::atomic<size_t> tailIndex {0};
+    };
+}
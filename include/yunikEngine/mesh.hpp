@@ -0,0 +1,289 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include "camera.hpp"
+#include "meshSimplifier.hpp"
+#include "shader.hpp"
+#include "stats.hpp"
+
+namespace yunikEngine {
+    /**************************************************************************/
+    /*                               MeshVertex                               */
+    /**************************************************************************/
+    struct MeshVertex {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec3 color;
+    };
+
+    /**************************************************************************/
+    /*                                  Mesh                                  */
+    /**************************************************************************/
+    /* Indexed triangle mesh with an LOD chain built when it is created. Every
+     * level indexes the same vertex buffer and lives in the same index buffer
+     * after the base level. Draw with a program whose attributes were bound
+     * through bindAttribLocations, picking the level with selectLOD. */
+    class Mesh {
+        /***************************** PUBLIC *********************************/
+        public:
+        /* Each ratio is a target fraction of the base triangle count */
+        static Mesh* create (const std::vector<MeshVertex>& vertices, const std::vector<unsigned int>& indices,
+            const std::vector<float>& lodRatios = {0.5f, 0.25f, 0.125f}) {
+            auto newMesh = new Mesh(vertices, indices, lodRatios);
+            if (!newMesh->isValid) {
+                newMesh->destroy();
+                return nullptr;
+            }
+            return newMesh;
+        }
+
+        /* Every mesh of the file is merged into one, in model space */
+        static Mesh* load (const char* path, const std::vector<float>& lodRatios = {0.5f, 0.25f, 0.125f}) {
+            Assimp::Importer importer;
+            const aiScene* scene = importer.ReadFile(path,
+                aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_PreTransformVertices);
+            if (!scene) {
+                fprintf(stderr, "Error: Cannot load mesh %s. %s\n", path, importer.GetErrorString());
+                return nullptr;
+            }
+
+            std::vector<MeshVertex> vertices;
+            std::vector<unsigned int> indices;
+            for (unsigned int m = 0; m < scene->mNumMeshes; ++m) {
+                const aiMesh* mesh = scene->mMeshes[m];
+                const unsigned int base = (unsigned int) vertices.size();
+                for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
+                    MeshVertex vertex;
+                    vertex.position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+                    vertex.normal = mesh->HasNormals() ? glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z) : glm::vec3(0.0f, 0.0f, 1.0f);
+                    vertex.color = mesh->HasVertexColors(0) ? glm::vec3(mesh->mColors[0][i].r, mesh->mColors[0][i].g, mesh->mColors[0][i].b) : glm::vec3(1.0f);
+                    vertices.push_back(vertex);
+                }
+                for (unsigned int f = 0; f < mesh->mNumFaces; ++f) {
+                    /* Points and lines survive triangulation */
+                    if (mesh->mFaces[f].mNumIndices != 3) {
+                        continue;
+                    }
+                    for (int i = 0; i < 3; ++i) {
+                        indices.push_back(base + mesh->mFaces[f].mIndices[i]);
+                    }
+                }
+            }
+
+            if (indices.empty()) {
+                fprintf(stderr, "Error: Mesh %s has no triangles\n", path);
+                return nullptr;
+            }
+            return create(vertices, indices, lodRatios);
+        }
+
+        void destroy (void) {
+            delete this;
+        }
+
+        /* Call before ShaderProgram::compile */
+        static void bindAttribLocations (ShaderProgram* program) {
+            program->bindAttribLocation(vertex_location, "aVertex");
+            program->bindAttribLocation(normal_location, "aNormal");
+            program->bindAttribLocation(color_location, "aColor");
+        }
+
+        int getLODCount (void) {
+            return (int) lods.size();
+        }
+
+        GLsizei getTriangleCount (int lod) {
+            return lods[lod].indexCount / 3;
+        }
+
+        /* Model space distance error of the level */
+        float getLODError (int lod) {
+            return lods[lod].error;
+        }
+
+        /* Largest screen space error, in pixels, a level may show */
+        void setLODThreshold (float pixels) {
+            lodThreshold = pixels;
+        }
+
+        /* Fraction of the threshold a level must clear before switching,
+         * so objects near a boundary do not flicker between levels */
+        void setLODHysteresis (float ratio) {
+            lodHysteresis = ratio;
+        }
+
+        /* Coarsest level whose projected error stays under the threshold,
+         * moving away from currentLOD only past the hysteresis band. The
+         * caller keeps currentLOD per instance. */
+        int selectLOD (int currentLOD, Camera* camera, const glm::mat4& modelMatrix, float viewportHeight) {
+            const int lodCount = (int) lods.size();
+            currentLOD = std::min(std::max(currentLOD, 0), lodCount - 1);
+            if (lodCount == 1) {
+                return 0;
+            }
+
+            const float modelScale = std::max(glm::length(glm::vec3(modelMatrix[0])),
+                std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+
+            float pixelsPerUnit;
+            if (camera->getOrtho()) {
+                pixelsPerUnit = camera->getProjMatrix()[1][1] * viewportHeight * 0.5f;
+            } else {
+                const glm::vec4 center = camera->getViewMatrix() * modelMatrix * glm::vec4(boundCenter, 1.0f);
+                const float distance = glm::length(glm::vec3(center)) - boundRadius * modelScale;
+                if (distance <= 0.0f) {
+                    return 0;
+                }
+                pixelsPerUnit = viewportHeight / (2.0f * distance * std::tan(glm::radians(camera->getFov()) * 0.5f));
+            }
+            pixelsPerUnit *= modelScale;
+
+            int target = 0;
+            for (int lod = lodCount - 1; lod > 0; --lod) {
+                if (lods[lod].error * pixelsPerUnit <= lodThreshold) {
+                    target = lod;
+                    break;
+                }
+            }
+
+            if (target > currentLOD) {
+                while (target > currentLOD && lods[target].error * pixelsPerUnit > lodThreshold * (1.0f - lodHysteresis)) {
+                    --target;
+                }
+            } else if (target < currentLOD) {
+                if (lods[currentLOD].error * pixelsPerUnit <= lodThreshold * (1.0f + lodHysteresis)) {
+                    target = currentLOD;
+                }
+            }
+            return target;
+        }
+
+        void draw (int lod = 0) {
+            const LOD& level = lods[std::min(std::max(lod, 0), (int) lods.size() - 1)];
+            glBindVertexArray(vertexArray);
+            glDrawElements(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT, (const void*) (level.indexOffset * sizeof(unsigned int)));
+            glBindVertexArray(0);
+            Stats::add(StatCounter::DRAW_CALLS);
+            Stats::add(StatCounter::TRIANGLES, level.indexCount / 3);
+        }
+
+        /**************************** PRIVATE *********************************/
+        private:
+        Mesh (const std::vector<MeshVertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<float>& lodRatios) {
+            if (vertices.empty() || indices.size() < 3) {
+                fprintf(stderr, "Error: Mesh is empty\n");
+                return;
+            }
+            for (unsigned int index : indices) {
+                if (index >= vertices.size()) {
+                    fprintf(stderr, "Error: Mesh index %u is out of range\n", index);
+                    return;
+                }
+            }
+
+            std::vector<glm::vec3> positions(vertices.size());
+            glm::vec3 boundMin = vertices[0].position;
+            glm::vec3 boundMax = vertices[0].position;
+            for (size_t i = 0; i < vertices.size(); ++i) {
+                positions[i] = vertices[i].position;
+                boundMin = glm::min(boundMin, positions[i]);
+                boundMax = glm::max(boundMax, positions[i]);
+            }
+            boundCenter = (boundMin + boundMax) * 0.5f;
+            for (const glm::vec3& position : positions) {
+                boundRadius = std::max(boundRadius, glm::length(position - boundCenter));
+            }
+
+            std::vector<unsigned int> chain(indices.begin(), indices.end() - indices.size() % 3);
+            lods.push_back({0, (GLsizei) chain.size(), 0.0f});
+            buildLODs(positions, lodRatios, &chain);
+
+            glGenVertexArrays(1, &vertexArray);
+            glGenBuffers(1, &vertexBuffer);
+            glGenBuffers(1, &indexBuffer);
+
+            glBindVertexArray(vertexArray);
+            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MeshVertex), vertices.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, chain.size() * sizeof(unsigned int), chain.data(), GL_STATIC_DRAW);
+
+            glVertexAttribPointer(vertex_location, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (const void*) offsetof(MeshVertex, position));
+            glVertexAttribPointer(normal_location, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (const void*) offsetof(MeshVertex, normal));
+            glVertexAttribPointer(color_location, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (const void*) offsetof(MeshVertex, color));
+            glEnableVertexAttribArray(vertex_location);
+            glEnableVertexAttribArray(normal_location);
+            glEnableVertexAttribArray(color_location);
+
+            glBindVertexArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+            Stats::add(StatCounter::BYTES_ALLOCATED, vertices.size() * sizeof(MeshVertex) + chain.size() * sizeof(unsigned int));
+
+            isValid = true;
+        }
+
+        ~Mesh (void) {
+            glDeleteBuffers(1, &indexBuffer);
+            glDeleteBuffers(1, &vertexBuffer);
+            glDeleteVertexArrays(1, &vertexArray);
+        }
+
+        /* One simplifier pass runs down the whole chain, so each level keeps
+         * the error accumulated by the levels before it. Levels are appended
+         * to the base indices. */
+        void buildLODs (const std::vector<glm::vec3>& positions, std::vector<float> lodRatios, std::vector<unsigned int>* chain) {
+            std::sort(lodRatios.begin(), lodRatios.end(), std::greater<float>());
+
+            const size_t baseIndexCount = chain->size();
+            meshSimplifier::Simplifier simplifier(positions, *chain);
+            for (float ratio : lodRatios) {
+                if (ratio <= 0.0f || ratio >= 1.0f) {
+                    continue;
+                }
+                const size_t targetIndexCount = (size_t) (baseIndexCount / 3 * ratio) * 3;
+                simplifier.run(targetIndexCount);
+
+                /* Stop once the simplifier cannot go further */
+                const std::vector<unsigned int> levelIndices = simplifier.getIndices();
+                if (levelIndices.empty() || (GLsizei) levelIndices.size() >= lods.back().indexCount) {
+                    break;
+                }
+                lods.push_back({chain->size(), (GLsizei) levelIndices.size(), simplifier.getError()});
+                chain->insert(chain->end(), levelIndices.begin(), levelIndices.end());
+            }
+        }
+
+        struct LOD {
+            size_t indexOffset;
+            GLsizei indexCount;
+            float error;
+        };
+
+        static const GLuint vertex_location = 0;
+        static const GLuint normal_location = 1;
+        static const GLuint color_location = 2;
+
+        GLuint vertexArray = 0;
+        GLuint vertexBuffer = 0;
+        GLuint indexBuffer = 0;
+
+        std::vector<LOD> lods;
+        glm::vec3 boundCenter = glm::vec3(0.0f);
+        float boundRadius = 0.0f;
+
+        float lodThreshold = 1.0f;
+        float lodHysteresis = 0.25f;
+
+        bool isValid = false;
+    };
+}
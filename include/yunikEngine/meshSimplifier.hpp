@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace yunikEngine {
+    /**************************************************************************/
+    /*                             meshSimplifier                             */
+    /**************************************************************************/
+    /* Quadric error edge collapse (Garland and Heckbert). Vertices are never
+     * moved: every collapse merges one endpoint into the other, so each level
+     * indexes the original vertex array and a whole LOD chain can share one
+     * vertex buffer. */
+    namespace meshSimplifier {
+        /* Symmetric 4x4 matrix: xx xy xz xw yy yz yw zz zw ww */
+        struct Quadric {
+            double a[10] = {};
+
+            void addPlane (double x, double y, double z, double w, double weight) {
+                a[0] += weight * x * x; a[1] += weight * x * y; a[2] += weight * x * z; a[3] += weight * x * w;
+                a[4] += weight * y * y; a[5] += weight * y * z; a[6] += weight * y * w;
+                a[7] += weight * z * z; a[8] += weight * z * w;
+                a[9] += weight * w * w;
+            }
+
+            void add (const Quadric& other) {
+                for (int i = 0; i < 10; ++i) {
+                    a[i] += other.a[i];
+                }
+            }
+
+            /* Sum of squared distances to the accumulated planes */
+            double evaluate (const glm::vec3& p) const {
+                const double x = p.x, y = p.y, z = p.z;
+                return a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x
+                     + a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y
+                     + a[7] * z * z + 2.0 * a[8] * z
+                     + a[9];
+            }
+        };
+
+        /* Open borders and attribute seams get perpendicular planes this much
+         * stronger than surface planes, so silhouettes do not shrink */
+        static const double border_weight = 10.0;
+
+        struct Collapse {
+            double cost;
+            unsigned int from;
+            unsigned int to;
+            unsigned int fromVersion;
+            unsigned int toVersion;
+
+            bool operator> (const Collapse& other) const {
+                return cost > other.cost;
+            }
+        };
+
+        class Simplifier {
+            public:
+            Simplifier (const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices)
+                : positions(positions), faces(indices) {
+                const size_t vertexNum = positions.size();
+                const size_t faceNum = indices.size() / 3;
+                faces.resize(faceNum * 3);
+                quadrics.resize(vertexNum);
+                vertexFaces.resize(vertexNum);
+                versions.assign(vertexNum, 0);
+                isRemoved.assign(vertexNum, false);
+                isFaceAlive.assign(faceNum, true);
+                liveFaceNum = faceNum;
+
+                std::unordered_map<uint64_t, int> edgeFaces;
+                for (size_t f = 0; f < faceNum; ++f) {
+                    const unsigned int* v = &faces[f * 3];
+                    for (int i = 0; i < 3; ++i) {
+                        vertexFaces[v[i]].push_back((unsigned int) f);
+                        edgeFaces[edgeKey(v[i], v[(i + 1) % 3])]++;
+                    }
+
+                    const glm::vec3 normal = faceNormal(v[0], v[1], v[2]);
+                    const float area = glm::length(normal);
+                    if (area <= 0.0f) {
+                        continue;
+                    }
+                    const glm::vec3 n = normal / area;
+                    const double w = -glm::dot(n, positions[v[0]]);
+                    for (int i = 0; i < 3; ++i) {
+                        quadrics[v[i]].addPlane(n.x, n.y, n.z, w, 1.0);
+                    }
+                }
+
+                for (size_t f = 0; f < faceNum; ++f) {
+                    const unsigned int* v = &faces[f * 3];
+                    const glm::vec3 normal = faceNormal(v[0], v[1], v[2]);
+                    for (int i = 0; i < 3; ++i) {
+                        const unsigned int a = v[i];
+                        const unsigned int b = v[(i + 1) % 3];
+                        if (edgeFaces[edgeKey(a, b)] != 1) {
+                            continue;
+                        }
+                        glm::vec3 n = glm::cross(positions[b] - positions[a], normal);
+                        const float length = glm::length(n);
+                        if (length <= 0.0f) {
+                            continue;
+                        }
+                        n = n / length;
+                        const double w = -glm::dot(n, positions[a]);
+                        quadrics[a].addPlane(n.x, n.y, n.z, w, border_weight);
+                        quadrics[b].addPlane(n.x, n.y, n.z, w, border_weight);
+                    }
+                }
+
+                for (auto& edge : edgeFaces) {
+                    pushCollapse((unsigned int) (edge.first >> 32), (unsigned int) (edge.first & 0xffffffffu));
+                }
+            }
+
+            /* Collapse until at most targetIndexCount indices remain or no
+             * valid collapse is left. Can be called with decreasing targets
+             * to snapshot a chain. */
+            void run (size_t targetIndexCount) {
+                while (liveFaceNum * 3 > targetIndexCount && !heap.empty()) {
+                    const Collapse collapse = heap.top();
+                    heap.pop();
+                    if (isRemoved[collapse.from] || isRemoved[collapse.to] ||
+                        versions[collapse.from] != collapse.fromVersion || versions[collapse.to] != collapse.toVersion) {
+                        continue;
+                    }
+                    if (!isCollapseValid(collapse.from, collapse.to)) {
+                        continue;
+                    }
+                    apply(collapse);
+                }
+            }
+
+            std::vector<unsigned int> getIndices (void) const {
+                std::vector<unsigned int> indices;
+                indices.reserve(liveFaceNum * 3);
+                for (size_t f = 0; f < isFaceAlive.size(); ++f) {
+                    if (isFaceAlive[f]) {
+                        indices.insert(indices.end(), faces.begin() + f * 3, faces.begin() + f * 3 + 3);
+                    }
+                }
+                return indices;
+            }
+
+            /* Largest distance error of the collapses made so far */
+            float getError (void) const {
+                return (float) std::sqrt(maxCost);
+            }
+
+            private:
+            static uint64_t edgeKey (unsigned int a, unsigned int b) {
+                return a < b ? ((uint64_t) a << 32) | b : ((uint64_t) b << 32) | a;
+            }
+
+            glm::vec3 faceNormal (unsigned int a, unsigned int b, unsigned int c) const {
+                return glm::cross(positions[b] - positions[a], positions[c] - positions[a]);
+            }
+
+            /* Queue the cheaper direction of the edge */
+            void pushCollapse (unsigned int a, unsigned int b) {
+                Quadric q = quadrics[a];
+                q.add(quadrics[b]);
+                const double costToA = std::max(q.evaluate(positions[a]), 0.0);
+                const double costToB = std::max(q.evaluate(positions[b]), 0.0);
+                if (costToB <= costToA) {
+                    heap.push({costToB, a, b, versions[a], versions[b]});
+                } else {
+                    heap.push({costToA, b, a, versions[b], versions[a]});
+                }
+            }
+
+            /* Reject collapses that flip or flatten a surviving face */
+            bool isCollapseValid (unsigned int from, unsigned int to) const {
+                for (unsigned int f : vertexFaces[from]) {
+                    if (!isFaceAlive[f]) {
+                        continue;
+                    }
+                    const unsigned int* v = &faces[f * 3];
+                    if (v[0] == to || v[1] == to || v[2] == to) {
+                        continue;
+                    }
+                    const glm::vec3 before = faceNormal(v[0], v[1], v[2]);
+                    const unsigned int a = v[0] == from ? to : v[0];
+                    const unsigned int b = v[1] == from ? to : v[1];
+                    const unsigned int c = v[2] == from ? to : v[2];
+                    const glm::vec3 after = faceNormal(a, b, c);
+                    if (glm::dot(before, after) <= 0.0f) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            void apply (const Collapse& collapse) {
+                const unsigned int from = collapse.from;
+                const unsigned int to = collapse.to;
+
+                for (unsigned int f : vertexFaces[from]) {
+                    if (!isFaceAlive[f]) {
+                        continue;
+                    }
+                    unsigned int* v = &faces[f * 3];
+                    if (v[0] == to || v[1] == to || v[2] == to) {
+                        isFaceAlive[f] = false;
+                        --liveFaceNum;
+                        continue;
+                    }
+                    for (int i = 0; i < 3; ++i) {
+                        if (v[i] == from) {
+                            v[i] = to;
+                        }
+                    }
+                    vertexFaces[to].push_back(f);
+                }
+                vertexFaces[from].clear();
+                isRemoved[from] = true;
+
+                quadrics[to].add(quadrics[from]);
+                versions[to]++;
+                maxCost = std::max(maxCost, collapse.cost);
+
+                /* Drop dead faces and requeue every edge around the survivor */
+                auto& toFaces = vertexFaces[to];
+                toFaces.erase(std::remove_if(toFaces.begin(), toFaces.end(),
+                    [this] (unsigned int f) { return !isFaceAlive[f]; }), toFaces.end());
+
+                neighbors.clear();
+                for (unsigned int f : toFaces) {
+                    for (int i = 0; i < 3; ++i) {
+                        if (faces[f * 3 + i] != to) {
+                            neighbors.push_back(faces[f * 3 + i]);
+                        }
+                    }
+                }
+                std::sort(neighbors.begin(), neighbors.end());
+                neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+                for (unsigned int neighbor : neighbors) {
+                    pushCollapse(to, neighbor);
+                }
+            }
+
+            const std::vector<glm::vec3>& positions;
+            std::vector<unsigned int> faces;
+            std::vector<Quadric> quadrics;
+            std::vector<std::vector<unsigned int>> vertexFaces;
+            std::vector<unsigned int> versions;
+            std::vector<bool> isRemoved;
+            std::vector<bool> isFaceAlive;
+            std::vector<unsigned int> neighbors;
+            size_t liveFaceNum = 0;
+            double maxCost = 0.0;
+
+            std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+        };
+    }
+}
@@ -0,0 +1,363 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <glm/glm.hpp>
+#include "camera.hpp"
+#include "workerPool.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define YUNIKENGINE_AVX2
+#endif
+
+namespace yunikEngine {
+    /**************************************************************************/
+    /*                            OcclusionCuller                             */
+    /**************************************************************************/
+    /* Software occlusion culling: low-poly occluders are rasterized on the CPU
+     * into a coarse depth buffer, and object bounds are tested against it
+     * before their draw calls are submitted. Depth is NDC z mapped to [0, 1],
+     * smaller is nearer. A second level keeps the farthest depth of each
+     * tile_size x tile_size tile so most tests never touch single pixels.
+     * Rasterization and the tile level are split into horizontal bands that
+     * are processed by a worker pool. Gaps between occluders narrower than
+     * a buffer pixel count as closed. */
+    class OcclusionCuller {
+        /***************************** PUBLIC *********************************/
+        public:
+        /* width is rounded up to a multiple of tile_size */
+        static OcclusionCuller* create (int width, int height) {
+            auto newOcclusionCuller = new OcclusionCuller(width, height);
+            if (!newOcclusionCuller->isValid) {
+                newOcclusionCuller->destroy();
+                return nullptr;
+            }
+            return newOcclusionCuller;
+        }
+
+        void destroy (void) {
+            delete this;
+        }
+
+        /* Threads used by rasterize, the calling one included. 0 means
+         * hardware concurrency */
+        void setThreadCount (int count) {
+            workerPool->destroy();
+            workerPool = WorkerPool::create(count);
+        }
+
+        /* Fall back to the scalar rasterizer, to compare the two. No effect
+         * without YUNIKENGINE_AVX2 */
+        void setAVX2Enabled (bool isEnabled) {
+            isAVX2Enabled = isEnabled;
+        }
+
+        void getSize (int* width, int* height) {
+            *width = bufferWidth;
+            *height = bufferHeight;
+        }
+
+        /* Start a new frame seen from the camera */
+        void begin (Camera* camera) {
+            viewProjMatrix = camera->getProjMatrix() * camera->getViewMatrix();
+            triangles.clear();
+        }
+
+        /* Queue an indexed triangle mesh as an occluder. Triangles with a
+         * vertex in front of the near plane are dropped, which only makes
+         * culling less aggressive. */
+        void addOccluder (const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices, const glm::mat4& modelMatrix) {
+            const glm::mat4 mvp = viewProjMatrix * modelMatrix;
+
+            std::vector<glm::vec3> screen(vertices.size());
+            std::vector<bool> isClipped(vertices.size());
+            for (size_t i = 0; i < vertices.size(); ++i) {
+                const glm::vec4 clip = mvp * glm::vec4(vertices[i], 1.0);
+                isClipped[i] = isNearClipped(clip);
+                if (!isClipped[i]) {
+                    screen[i] = toScreen(clip);
+                }
+            }
+
+            for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+                const unsigned int i0 = indices[i], i1 = indices[i + 1], i2 = indices[i + 2];
+                if (isClipped[i0] || isClipped[i1] || isClipped[i2]) {
+                    continue;
+                }
+                setupTriangle(screen[i0], screen[i1], screen[i2]);
+            }
+        }
+
+        /* Rasterize the queued occluders and build the tile level */
+        void rasterize (void) {
+            const int workers = std::max(1, std::min(workerPool->getThreadCount(), tileRows));
+            workerPool->run(workers, [this, workers] (int i) {
+                rasterizeBand(tileRows * i / workers, tileRows * (i + 1) / workers);
+            });
+        }
+
+        /* false if the box is outside the view or hidden by the occluders */
+        bool isVisible (glm::vec3 boxMin, glm::vec3 boxMax, const glm::mat4& modelMatrix) {
+            const glm::mat4 mvp = viewProjMatrix * modelMatrix;
+
+            float minX = (float) bufferWidth, minY = (float) bufferHeight, minZ = 2.0f;
+            float maxX = 0.0f, maxY = 0.0f;
+            for (int corner = 0; corner < 8; ++corner) {
+                const glm::vec3 pos((corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y, (corner & 4) ? boxMax.z : boxMin.z);
+                const glm::vec4 clip = mvp * glm::vec4(pos, 1.0);
+                if (isNearClipped(clip)) {
+                    /* Crosses the near plane: too close to be hidden */
+                    return true;
+                }
+                const glm::vec3 screenPos = toScreen(clip);
+                minX = std::min(minX, screenPos.x);
+                minY = std::min(minY, screenPos.y);
+                minZ = std::min(minZ, screenPos.z);
+                maxX = std::max(maxX, screenPos.x);
+                maxY = std::max(maxY, screenPos.y);
+            }
+
+            if (maxX < 0.0f || maxY < 0.0f || minX >= bufferWidth || minY >= bufferHeight || minZ > 1.0f) {
+                return false;
+            }
+
+            /* Every pixel touched by the screen rectangle, plus one: center
+             * sampling lets an occluder cover up to half a pixel too much */
+            const int x0 = std::max(0, (int) std::floor(minX) - 1);
+            const int y0 = std::max(0, (int) std::floor(minY) - 1);
+            const int x1 = std::min(bufferWidth - 1, (int) std::floor(maxX) + 1);
+            const int y1 = std::min(bufferHeight - 1, (int) std::floor(maxY) + 1);
+
+            for (int tileY = y0 / tile_size; tileY <= y1 / tile_size; ++tileY) {
+                for (int tileX = x0 / tile_size; tileX <= x1 / tile_size; ++tileX) {
+                    if (minZ >= tileDepth[tileY * tileColumns + tileX]) {
+                        continue;
+                    }
+                    /* Tile only partially occludes: look at its pixels */
+                    const int pixelY1 = std::min(y1, tileY * tile_size + tile_size - 1);
+                    const int pixelX1 = std::min(x1, tileX * tile_size + tile_size - 1);
+                    for (int y = std::max(y0, tileY * tile_size); y <= pixelY1; ++y) {
+                        for (int x = std::max(x0, tileX * tile_size); x <= pixelX1; ++x) {
+                            if (minZ < depth[y * bufferWidth + x]) {
+                                return true;
+                            }
+                        }
+                    }
+                }
+            }
+            return false;
+        }
+
+        /* Depth of a pixel, row 0 at the bottom */
+        float getDepth (int x, int y) {
+            return depth[y * bufferWidth + x];
+        }
+
+        /**************************** PRIVATE *********************************/
+        private:
+        struct Triangle {
+            /* Pixel bounds */
+            int minX, minY, maxX, maxY;
+
+            /* Edge functions e(x, y) = a * x + b * y + c, inside when all >= 0 */
+            float edgeA[3], edgeB[3], edgeC[3];
+
+            /* Depth plane z(x, y) = a * x + b * y + c */
+            float depthA, depthB, depthC;
+        };
+
+        OcclusionCuller (int width, int height) {
+            if (width <= 0 || height <= 0) {
+                fprintf(stderr, "Error: Wrong occlusion buffer size\n");
+                return;
+            }
+            bufferWidth = (width + tile_size - 1) / tile_size * tile_size;
+            bufferHeight = height;
+            tileColumns = bufferWidth / tile_size;
+            tileRows = (bufferHeight + tile_size - 1) / tile_size;
+
+            depth.resize(bufferWidth * bufferHeight, 1.0f);
+            tileDepth.resize(tileColumns * tileRows, 1.0f);
+
+            workerPool = WorkerPool::create(0);
+
+            isValid = true;
+        }
+
+        ~OcclusionCuller (void) {
+            if (workerPool != nullptr) {
+                workerPool->destroy();
+            }
+        }
+
+        /* In front of the near plane, or behind the camera. Also keeps w
+         * positive for the perspective divide. */
+        static bool isNearClipped (const glm::vec4& clip) {
+            return clip.z < -clip.w;
+        }
+
+        glm::vec3 toScreen (const glm::vec4& clip) {
+            const float invW = 1.0f / clip.w;
+            return glm::vec3((clip.x * invW * 0.5f + 0.5f) * bufferWidth,
+                             (clip.y * invW * 0.5f + 0.5f) * bufferHeight,
+                             clip.z * invW * 0.5f + 0.5f);
+        }
+
+        void setupTriangle (glm::vec3 v0, glm::vec3 v1, glm::vec3 v2) {
+            float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+            if (std::fabs(area) < 1e-8f) {
+                return;
+            }
+            if (area < 0.0f) {
+                std::swap(v1, v2);
+                area = -area;
+            }
+
+            Triangle triangle;
+            triangle.minX = std::max(0, (int) std::floor(std::min(std::min(v0.x, v1.x), v2.x)));
+            triangle.minY = std::max(0, (int) std::floor(std::min(std::min(v0.y, v1.y), v2.y)));
+            triangle.maxX = std::min(bufferWidth - 1, (int) std::ceil(std::max(std::max(v0.x, v1.x), v2.x)));
+            triangle.maxY = std::min(bufferHeight - 1, (int) std::ceil(std::max(std::max(v0.y, v1.y), v2.y)));
+            if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+                return;
+            }
+
+            /* Coverage is sampled at pixel centers, so neighbouring triangles
+             * leave no holes. Depth is the farthest the plane reaches inside
+             * the pixel. */
+            const glm::vec3 v[3] = {v0, v1, v2};
+            for (int i = 0; i < 3; ++i) {
+                const glm::vec3& a = v[i];
+                const glm::vec3& b = v[(i + 1) % 3];
+                triangle.edgeA[i] = a.y - b.y;
+                triangle.edgeB[i] = b.x - a.x;
+                triangle.edgeC[i] = a.x * b.y - b.x * a.y;
+            }
+
+            triangle.depthA = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+            triangle.depthB = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+            triangle.depthC = v0.z - triangle.depthA * v0.x - triangle.depthB * v0.y + 0.5f * (std::fabs(triangle.depthA) + std::fabs(triangle.depthB));
+
+            triangles.push_back(triangle);
+        }
+
+        /* Rasterize every triangle into the rows of tiles [tileRowBegin, tileRowEnd) */
+        void rasterizeBand (int tileRowBegin, int tileRowEnd) {
+            const int bandMinY = tileRowBegin * tile_size;
+            const int bandMaxY = std::min(bufferHeight, tileRowEnd * tile_size) - 1;
+
+            std::fill(depth.begin() + bandMinY * bufferWidth, depth.begin() + (bandMaxY + 1) * bufferWidth, 1.0f);
+
+            for (const Triangle& triangle : triangles) {
+                const int minY = std::max(triangle.minY, bandMinY);
+                const int maxY = std::min(triangle.maxY, bandMaxY);
+                for (int y = minY; y <= maxY; ++y) {
+                    rasterizeRow(triangle, y);
+                }
+            }
+
+            for (int tileY = tileRowBegin; tileY < tileRowEnd; ++tileY) {
+                for (int tileX = 0; tileX < tileColumns; ++tileX) {
+                    float farthest = 0.0f;
+                    const int pixelY1 = std::min(bufferHeight, tileY * tile_size + tile_size);
+                    for (int y = tileY * tile_size; y < pixelY1; ++y) {
+                        const float* row = &depth[y * bufferWidth + tileX * tile_size];
+                        for (int x = 0; x < tile_size; ++x) {
+                            farthest = std::max(farthest, row[x]);
+                        }
+                    }
+                    tileDepth[tileY * tileColumns + tileX] = farthest;
+                }
+            }
+        }
+
+        /* Rows are processed in chunks of tile_size pixels, which never cross
+         * the row end */
+        void rasterizeRow (const Triangle& triangle, int y) {
+#ifdef YUNIKENGINE_AVX2
+            if (isAVX2Enabled) {
+                rasterizeRowAVX2(triangle, y);
+                return;
+            }
+#endif
+            rasterizeRowScalar(triangle, y);
+        }
+
+#ifdef YUNIKENGINE_AVX2
+        void rasterizeRowAVX2 (const Triangle& triangle, int y) {
+            const float py = y + 0.5f;
+            float* row = &depth[y * bufferWidth];
+            const int chunkBegin = triangle.minX / tile_size * tile_size;
+
+            const __m256 laneOffsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+            const __m256 zero = _mm256_setzero_ps();
+            __m256 edgeA[3], edgeRow[3];
+            for (int i = 0; i < 3; ++i) {
+                edgeA[i] = _mm256_set1_ps(triangle.edgeA[i]);
+                edgeRow[i] = _mm256_set1_ps(triangle.edgeB[i] * py + triangle.edgeC[i]);
+            }
+            const __m256 depthA = _mm256_set1_ps(triangle.depthA);
+            const __m256 depthRow = _mm256_set1_ps(triangle.depthB * py + triangle.depthC);
+
+            for (int x = chunkBegin; x <= triangle.maxX; x += tile_size) {
+                const __m256 px = _mm256_add_ps(_mm256_set1_ps((float) x), laneOffsets);
+                __m256 isInside = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edgeA[0], px), edgeRow[0]), zero, _CMP_GE_OQ);
+                isInside = _mm256_and_ps(isInside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edgeA[1], px), edgeRow[1]), zero, _CMP_GE_OQ));
+                isInside = _mm256_and_ps(isInside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edgeA[2], px), edgeRow[2]), zero, _CMP_GE_OQ));
+                if (_mm256_testz_ps(isInside, isInside)) {
+                    continue;
+                }
+
+                const __m256 z = _mm256_add_ps(_mm256_mul_ps(depthA, px), depthRow);
+                const __m256 oldZ = _mm256_loadu_ps(row + x);
+                _mm256_storeu_ps(row + x, _mm256_blendv_ps(oldZ, _mm256_min_ps(oldZ, z), isInside));
+            }
+        }
+#endif
+
+        void rasterizeRowScalar (const Triangle& triangle, int y) {
+            const float py = y + 0.5f;
+            float* row = &depth[y * bufferWidth];
+            const int chunkBegin = triangle.minX / tile_size * tile_size;
+
+            const float edgeRow[3] = {
+                triangle.edgeB[0] * py + triangle.edgeC[0],
+                triangle.edgeB[1] * py + triangle.edgeC[1],
+                triangle.edgeB[2] * py + triangle.edgeC[2]
+            };
+            const float depthRow = triangle.depthB * py + triangle.depthC;
+
+            const int end = std::min(bufferWidth, (triangle.maxX / tile_size + 1) * tile_size);
+            for (int x = chunkBegin; x < end; ++x) {
+                const float px = x + 0.5f;
+                if (triangle.edgeA[0] * px + edgeRow[0] >= 0.0f
+                    && triangle.edgeA[1] * px + edgeRow[1] >= 0.0f
+                    && triangle.edgeA[2] * px + edgeRow[2] >= 0.0f) {
+                    row[x] = std::min(row[x], triangle.depthA * px + depthRow);
+                }
+            }
+        }
+
+        /* Rows are chunked by 8 pixels for AVX2 */
+        static const int tile_size = 8;
+
+        int bufferWidth = 0;
+        int bufferHeight = 0;
+        int tileColumns = 0;
+        int tileRows = 0;
+        bool isAVX2Enabled = true;
+
+        WorkerPool* workerPool = nullptr;
+
+        std::vector<float> depth;
+        std::vector<float> tileDepth;
+        std::vector<Triangle> triangles;
+
+        glm::mat4 viewProjMatrix = glm::mat4(1.0f);
+
+        bool isValid = false;
+    };
+}
@@ -5,5 +5,10 @@ namespace yunikEngine {
         public:
         virtual ~Scene (void) {}
         virtual Scene* update (void) = 0;
+
+        /* Issue draw calls for the state computed by the last update. In
+         * threaded rendering mode this runs on the render thread, which owns
+         * the GL context, while update runs on the main thread. */
+        virtual void draw (void) {}
     };
 }
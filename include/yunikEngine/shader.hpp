@@ -1,8 +1,16 @@
 #pragma once
 
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <functional>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "stats.hpp"
 #include "window.hpp"
 
 namespace yunikEngine {
@@ -101,17 +109,23 @@ namespace yunikEngine {
             glAttachShader(program, shader->getShader());
         }
 
+        /* Takes effect at the next compile */
+        void bindAttribLocation (GLuint index, const char* name) {
+            glBindAttribLocation(program, index, name);
+        }
+
         bool compile (void) {
             glLinkProgram(program);
             
-            GLint isCompiled = 0;
-            glGetShaderiv(program, GL_COMPILE_STATUS, &isCompiled);
-            if (isCompiled == GL_FALSE) {
+            GLint isLinked = 0;
+            glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+            if (isLinked == GL_FALSE) {
                 GLint maxLength = 0;
-                glGetShaderiv(program, GL_INFO_LOG_LENGTH, &maxLength);
+                glGetProgramiv(program, GL_INFO_LOG_LENGTH, &maxLength);
 
-                GLchar* errorLog = new GLchar[maxLength];
-                glGetShaderInfoLog(program, maxLength, &maxLength, errorLog);
+                GLchar* errorLog = new GLchar[maxLength + 1];
+                errorLog[0] = '\0';
+                glGetProgramInfoLog(program, maxLength + 1, nullptr, errorLog);
                 fprintf(stderr, "Error: ShaderProgram compilation failed. %s\n", errorLog);
                 delete[] errorLog;
                 return false;
@@ -121,14 +135,37 @@ namespace yunikEngine {
 
         void use (void) {
             glUseProgram(program);
+            Stats::add(StatCounter::PROGRAM_BINDS);
         }
 
         void setInt (const char* name, int value) {
             glUniform1i(glGetUniformLocation(program, name), value);
+            Stats::add(StatCounter::UNIFORM_UPLOADS);
         }
 
         void setFloat (const char* name, float value) {
             glUniform1f(glGetUniformLocation(program, name), value);
+            Stats::add(StatCounter::UNIFORM_UPLOADS);
+        }
+
+        void setVec2 (const char* name, glm::vec2 value) {
+            glUniform2f(glGetUniformLocation(program, name), value.x, value.y);
+            Stats::add(StatCounter::UNIFORM_UPLOADS);
+        }
+
+        void setVec3 (const char* name, glm::vec3 value) {
+            glUniform3f(glGetUniformLocation(program, name), value.x, value.y, value.z);
+            Stats::add(StatCounter::UNIFORM_UPLOADS);
+        }
+
+        void setVec4 (const char* name, glm::vec4 value) {
+            glUniform4f(glGetUniformLocation(program, name), value.x, value.y, value.z, value.w);
+            Stats::add(StatCounter::UNIFORM_UPLOADS);
+        }
+
+        void setMat4 (const char* name, const glm::mat4& value) {
+            glUniformMatrix4fv(glGetUniformLocation(program, name), 1, GL_FALSE, &value[0][0]);
+            Stats::add(StatCounter::UNIFORM_UPLOADS);
         }
 
         /**************************** PRIVATE *********************************/
@@ -149,6 +186,180 @@ namespace yunikEngine {
         bool isValid = false;
     };
 
+    /**************************************************************************/
+    /*                             ShaderVariants                             */
+    /**************************************************************************/
+    /* Compile-time permutations of one vertex/fragment shader pair. Sources are
+     * written without a #version line and branch on the declared keywords with
+     * #ifdef. A variant is addressed by a bitmask key (bit i = keywords[i]) and
+     * compiled lazily on first use. A stage only receives the #defines of the
+     * keywords its source mentions, and identical preprocessed stages and
+     * programs are shared between variants. */
+    class ShaderVariants {
+        /***************************** PUBLIC *********************************/
+        public:
+        typedef uint32_t Key;
+
+        static ShaderVariants* create (const char* vertexSrc, const char* fragmentSrc, const std::vector<std::string>& keywords) {
+            auto newShaderVariants = new ShaderVariants(vertexSrc, fragmentSrc, keywords);
+            if (!newShaderVariants->isValid) {
+                newShaderVariants->destroy();
+                return nullptr;
+            }
+            return newShaderVariants;
+        }
+
+        void destroy (void) {
+            delete this;
+        }
+
+        /* Bit of a keyword, or 0 if it is not declared */
+        Key getKeywordBit (const char* keyword) {
+            for (size_t i = 0; i < keywords.size(); ++i) {
+                if (keywords[i] == keyword) {
+                    return Key(1) << i;
+                }
+            }
+            fprintf(stderr, "Error: Unknown shader keyword %s\n", keyword);
+            return 0;
+        }
+
+        /* Program of the variant, compiled on first use. nullptr if it fails */
+        ShaderProgram* getProgram (Key key) {
+            auto variant = variants.find(key);
+            if (variant != variants.end()) {
+                return variant->second;
+            }
+
+            /* Failures are cached as well so they are not recompiled each frame */
+            ShaderProgram* program = nullptr;
+            Shader* vertexShader = getShader(vertexSource, vertexKeywordMask & key, ShaderType::VERTEX);
+            Shader* fragmentShader = getShader(fragmentSource, fragmentKeywordMask & key, ShaderType::FRAGMENT);
+            if (vertexShader != nullptr && fragmentShader != nullptr) {
+                program = getLinkedProgram(vertexShader, fragmentShader);
+            }
+            variants[key] = program;
+            return program;
+        }
+
+        /* Number of distinct programs actually compiled */
+        size_t getProgramCount (void) {
+            return programs.size();
+        }
+
+        /**************************** PRIVATE *********************************/
+        private:
+        ShaderVariants (const char* vertexSrc, const char* fragmentSrc, const std::vector<std::string>& keywords) {
+            if (keywords.size() > sizeof(Key) * 8) {
+                fprintf(stderr, "Error: Too many shader keywords\n");
+                return;
+            }
+            vertexSource = vertexSrc;
+            fragmentSource = fragmentSrc;
+            this->keywords = keywords;
+            vertexKeywordMask = getUsedKeywordMask(vertexSource);
+            fragmentKeywordMask = getUsedKeywordMask(fragmentSource);
+
+            isValid = true;
+        }
+
+        ~ShaderVariants (void) {
+            for (auto& program : programs) {
+                program.second->destroy();
+            }
+            for (auto& shader : shaders) {
+                if (shader.second.second != nullptr) {
+                    shader.second.second->destroy();
+                }
+            }
+            for (auto shader : orphanShaders) {
+                shader->destroy();
+            }
+        }
+
+        /* A keyword whose name never appears in a source cannot change it */
+        Key getUsedKeywordMask (const std::string& source) {
+            Key mask = 0;
+            for (size_t i = 0; i < keywords.size(); ++i) {
+                if (source.find(keywords[i]) != std::string::npos) {
+                    mask |= Key(1) << i;
+                }
+            }
+            return mask;
+        }
+
+        std::string preprocess (const std::string& source, Key key) {
+            char* glslCore = Window::getGLSLCore();
+            std::string code = glslCore;
+            delete[] glslCore;
+            for (size_t i = 0; i < keywords.size(); ++i) {
+                if (key & (Key(1) << i)) {
+                    code += "#define " + keywords[i] + "\n";
+                }
+            }
+            return code + source;
+        }
+
+        Shader* getShader (const std::string& source, Key key, ShaderType shaderType) {
+            std::string code = preprocess(source, key);
+            size_t hash = std::hash<std::string>()(code);
+
+            auto cached = shaders.find(hash);
+            if (cached != shaders.end() && cached->second.first == code) {
+                return cached->second.second;
+            }
+
+            Shader* shader = Shader::create(code.c_str(), shaderType);
+            if (cached == shaders.end()) {
+                shaders[hash] = std::make_pair(code, shader);
+            } else if (shader != nullptr) {
+                /* Hash collision: keep the first entry, own this one */
+                orphanShaders.push_back(shader);
+            }
+            return shader;
+        }
+
+        ShaderProgram* getLinkedProgram (Shader* vertexShader, Shader* fragmentShader) {
+            auto stages = std::make_pair(vertexShader, fragmentShader);
+            auto cached = programs.find(stages);
+            if (cached != programs.end()) {
+                return cached->second;
+            }
+
+            ShaderProgram* program = ShaderProgram::create();
+            if (program == nullptr) {
+                return nullptr;
+            }
+            program->attachShader(vertexShader);
+            program->attachShader(fragmentShader);
+            if (!program->compile()) {
+                program->destroy();
+                return nullptr;
+            }
+            programs[stages] = program;
+            return program;
+        }
+
+        struct ShaderPairHash {
+            size_t operator() (const std::pair<Shader*, Shader*>& stages) const {
+                return std::hash<Shader*>()(stages.first) * 31 + std::hash<Shader*>()(stages.second);
+            }
+        };
+
+        std::string vertexSource;
+        std::string fragmentSource;
+        std::vector<std::string> keywords;
+        Key vertexKeywordMask = 0;
+        Key fragmentKeywordMask = 0;
+
+        std::unordered_map<size_t, std::pair<std::string, Shader*>> shaders;
+        std::vector<Shader*> orphanShaders;
+        std::unordered_map<std::pair<Shader*, Shader*>, ShaderProgram*, ShaderPairHash> programs;
+        std::unordered_map<Key, ShaderProgram*> variants;
+
+        bool isValid = false;
+    };
+
     /**************************************************************************/
     /*                            Shader examples                             */
     /**************************************************************************/
@@ -180,7 +391,7 @@ namespace yunikEngine {
             delete glslCore;
             int shaderSize = shader_str.size();
             char* shader = new char[shaderSize + 1];
-            strcpy_s(shader, shaderSize + 1, shader_str.c_str());
+            memcpy(shader, shader_str.c_str(), shaderSize + 1);
             return shader;
         }
 
@@ -201,7 +412,64 @@ namespace yunikEngine {
             delete glslCore;
             int shaderSize = shader_str.size();
             char* shader = new char[shaderSize + 1];
-            strcpy_s(shader, shaderSize + 1, shader_str.c_str());
+            memcpy(shader, shader_str.c_str(), shaderSize + 1);
+            return shader;
+        }
+
+        /* Forward shading with the light lists of ClusteredLighting */
+        char* clusteredFragmentShader (void) {
+            char* glslCore = Window::getGLSLCore();
+            std::string code = "\
+                uniform samplerBuffer uLights;\
+                uniform usamplerBuffer uClusterGrid;\
+                uniform usamplerBuffer uLightIndices;\
+                uniform vec3 uClusterDims;\
+                uniform vec4 uViewport;\
+                uniform vec3 uSliceParams;\
+                uniform vec3 uAmbient;\
+                \
+                in vec3 vColor;\
+                in vec3 vNormal;\
+                in vec4 vPosition;\
+                \
+                out vec4 fragColor;\
+                \
+                void main (void) {\
+                    ivec3 dims = ivec3(uClusterDims);\
+                    vec2 tile = (gl_FragCoord.xy - uViewport.xy) / uViewport.zw;\
+                    int cx = clamp(int(tile.x * float(dims.x)), 0, dims.x - 1);\
+                    int cy = clamp(int(tile.y * float(dims.y)), 0, dims.y - 1);\
+                    float depth = -vPosition.z;\
+                    float slice = (uSliceParams.z > 0.5 ? log(max(depth, 1e-6)) : depth) * uSliceParams.x - uSliceParams.y;\
+                    int cz = clamp(int(slice), 0, dims.z - 1);\
+                    uvec2 cluster = texelFetch(uClusterGrid, (cz * dims.y + cy) * dims.x + cx).xy;\
+                    \
+                    vec3 normal = normalize(vNormal);\
+                    vec3 lighting = uAmbient;\
+                    for (uint i = 0u; i < cluster.y; ++i) {\
+                        int light = int(texelFetch(uLightIndices, int(cluster.x + i)).x);\
+                        vec4 posRadius = texelFetch(uLights, light * 3);\
+                        vec4 colorType = texelFetch(uLights, light * 3 + 1);\
+                        vec4 dirCone = texelFetch(uLights, light * 3 + 2);\
+                        \
+                        vec3 toLight = posRadius.xyz - vPosition.xyz;\
+                        float dist = length(toLight);\
+                        vec3 l = toLight / max(dist, 1e-6);\
+                        float attenuation = clamp(1.0 - dist / posRadius.w, 0.0, 1.0);\
+                        attenuation *= attenuation;\
+                        if (colorType.w > 0.5) {\
+                            attenuation *= smoothstep(dirCone.w, mix(dirCone.w, 1.0, 0.1), dot(-l, dirCone.xyz));\
+                        }\
+                        lighting += colorType.rgb * attenuation * max(dot(normal, l), 0.0);\
+                    }\
+                    fragColor = vec4(vColor * lighting, 1.0);\
+                }\
+            ";
+            std::string shader_str = std::string(glslCore) + code;
+            delete glslCore;
+            int shaderSize = shader_str.size();
+            char* shader = new char[shaderSize + 1];
+            memcpy(shader, shader_str.c_str(), shaderSize + 1);
             return shader;
         }
     }
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+/* Kept out of stats.hpp, which every header includes: windows.h would leak
+ * its min and max macros everywhere */
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "stats.hpp"
+
+namespace yunikEngine {
+    /**************************************************************************/
+    /*                            SocketStatsSink                             */
+    /**************************************************************************/
+    /* One JSON datagram per frame sent to a UDP port on the loopback interface */
+    class SocketStatsSink : public StatsSink {
+        /***************************** PUBLIC *********************************/
+        public:
+        static SocketStatsSink* create (unsigned short port) {
+            auto newSink = new SocketStatsSink(port);
+            if (!newSink->isValid) {
+                delete newSink;
+                return nullptr;
+            }
+            return newSink;
+        }
+
+        ~SocketStatsSink (void) {
+#ifdef _WIN32
+            if (sock != INVALID_SOCKET) {
+                closesocket(sock);
+            }
+            if (isWSAStarted) {
+                WSACleanup();
+            }
+#else
+            if (sock >= 0) {
+                close(sock);
+            }
+#endif
+        }
+
+        void write (const StatsSnapshot& snapshot) override {
+            const std::string json = snapshot.toJSON();
+            sendto(sock, json.c_str(), (int) json.size(), 0, (const sockaddr*) &address, sizeof(address));
+        }
+
+        /**************************** PRIVATE *********************************/
+        private:
+        SocketStatsSink (unsigned short port) {
+#ifdef _WIN32
+            WSADATA wsaData;
+            if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+                fprintf(stderr, "Error: Cannot initialize Winsock\n");
+                return;
+            }
+            isWSAStarted = true;
+            sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+            if (sock == INVALID_SOCKET) {
+                fprintf(stderr, "Error: Cannot create stats socket\n");
+                return;
+            }
+#else
+            sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+            if (sock < 0) {
+                fprintf(stderr, "Error: Cannot create stats socket\n");
+                return;
+            }
+#endif
+            address.sin_family = AF_INET;
+            address.sin_port = htons(port);
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+            isValid = true;
+        }
+
+#ifdef _WIN32
+        SOCKET sock = INVALID_SOCKET;
+        bool isWSAStarted = false;
+#else
+        int sock = -1;
+#endif
+        sockaddr_in address = {};
+
+        bool isValid = false;
+    };
+}
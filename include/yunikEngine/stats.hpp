@@ -0,0 +1,239 @@
+#pragma once
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+namespace yunikEngine {
+    /**************************************************************************/
+    /*                              StatCounter                               */
+    /**************************************************************************/
+    enum class StatCounter : int {
+        /* Mesh::draw reports these, scenes report their own draws */
+        DRAW_CALLS,
+        TRIANGLES,
+        PROGRAM_BINDS,
+        UNIFORM_UPLOADS,
+        AL_CALLS,
+        SCENE_SWITCHES,
+        BYTES_LOADED,
+        BYTES_ALLOCATED,
+        COUNT
+    };
+
+    /**************************************************************************/
+    /*                               StatGauge                                */
+    /**************************************************************************/
+    enum class StatGauge : int {
+        FRAME_TIME_US,
+        INPUT_LATENCY_US,
+        RESOLUTION_SCALE_PERMILLE,
+        COUNT
+    };
+
+    /**************************************************************************/
+    /*                             StatsSnapshot                              */
+    /**************************************************************************/
+    struct StatsSnapshot {
+        static const int counter_num = static_cast<int>(StatCounter::COUNT);
+        static const int gauge_num = static_cast<int>(StatGauge::COUNT);
+
+        uint64_t frame = 0;
+        uint64_t perFrame[counter_num] = {};
+        uint64_t total[counter_num] = {};
+        int64_t gauges[gauge_num] = {};
+
+        /* One line of JSON, without the trailing newline */
+        std::string toJSON (void) const {
+            static const char* counterNames[counter_num] = {
+                "draw_calls", "triangles", "program_binds", "uniform_uploads", "al_calls",
+                "scene_switches", "bytes_loaded", "bytes_allocated"
+            };
+            static const char* gaugeNames[gauge_num] = {
+                "frame_time_us", "input_latency_us", "resolution_scale_permille"
+            };
+
+            char item[96];
+            snprintf(item, sizeof(item), "{\"frame\":%" PRIu64, frame);
+            std::string json = item;
+            for (int i = 0; i < counter_num; ++i) {
+                snprintf(item, sizeof(item), ",\"%s\":[%" PRIu64 ",%" PRIu64 "]", counterNames[i], perFrame[i], total[i]);
+                json += item;
+            }
+            for (int i = 0; i < gauge_num; ++i) {
+                snprintf(item, sizeof(item), ",\"%s\":%" PRId64, gaugeNames[i], gauges[i]);
+                json += item;
+            }
+            return json + "}";
+        }
+    };
+
+    /**************************************************************************/
+    /*                               StatsSink                                */
+    /**************************************************************************/
+    class StatsSink {
+        public:
+        virtual ~StatsSink (void) {}
+        virtual void write (const StatsSnapshot& snapshot) = 0;
+    };
+
+    /* JSON lines appended to a file */
+    class FileStatsSink : public StatsSink {
+        /***************************** PUBLIC *********************************/
+        public:
+        static FileStatsSink* create (const char* path) {
+            auto newSink = new FileStatsSink(path);
+            if (!newSink->isValid) {
+                delete newSink;
+                return nullptr;
+            }
+            return newSink;
+        }
+
+        ~FileStatsSink (void) {
+            if (fp) {
+                fclose(fp);
+            }
+        }
+
+        /* Flushed per line so readers see each frame as it ends */
+        void write (const StatsSnapshot& snapshot) override {
+            fprintf(fp, "%s\n", snapshot.toJSON().c_str());
+            fflush(fp);
+        }
+
+        /**************************** PRIVATE *********************************/
+        private:
+        FileStatsSink (const char* path) {
+            fp = fopen(path, "w");
+            if (!fp) {
+                fprintf(stderr, "Error: Cannot open stats file %s\n", path);
+                return;
+            }
+            isValid = true;
+        }
+
+        FILE* fp = nullptr;
+
+        bool isValid = false;
+    };
+
+    /**************************************************************************/
+    /*                                 Stats                                  */
+    /**************************************************************************/
+    /* Engine activity counters. Updates are relaxed atomics behind a relaxed
+     * enabled flag, so they cost a load and a branch until someone enables
+     * stats or attaches a sink. Window calls endFrame after each swap.
+     *
+     * With threaded rendering the main thread updates frame N+1 while the
+     * render thread still swaps frame N, so the two sides count separately:
+     * update-side counts are closed when the render thread picks a frame up,
+     * render-side counts when that frame ends. */
+    class Stats {
+        /***************************** PUBLIC *********************************/
+        public:
+        static void setEnabled (bool isEnabled) {
+            enabled.store(isEnabled, std::memory_order_relaxed);
+        }
+
+        static bool isEnabled (void) {
+            return enabled.load(std::memory_order_relaxed);
+        }
+
+        /* Takes ownership of the sink, nullptr detaches. Enables stats. */
+        static void setSink (StatsSink* newSink) {
+            std::lock_guard<std::mutex> lock(snapshotMutex);
+            delete sink;
+            sink = newSink;
+            if (sink != nullptr) {
+                setEnabled(true);
+            }
+        }
+
+        static void add (StatCounter counter, uint64_t value = 1) {
+            if (!enabled.load(std::memory_order_relaxed)) {
+                return;
+            }
+            auto counters = isRenderThread ? renderCounters : updateCounters;
+            counters[static_cast<int>(counter)].fetch_add(value, std::memory_order_relaxed);
+        }
+
+        /* Count the calling thread's activity on the render side */
+        static void setRenderThread (bool isRender) {
+            isRenderThread = isRender;
+        }
+
+        /* Assign the update-side counts so far to the frame about to be
+         * drawn. Call while the update side is idle. */
+        static void closeUpdate (void) {
+            if (!enabled.load(std::memory_order_relaxed)) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(snapshotMutex);
+            for (int i = 0; i < StatsSnapshot::counter_num; ++i) {
+                closedUpdateCounters[i] += updateCounters[i].exchange(0, std::memory_order_relaxed);
+            }
+        }
+
+        static void setGauge (StatGauge gauge, int64_t value) {
+            if (!enabled.load(std::memory_order_relaxed)) {
+                return;
+            }
+            gauges[static_cast<int>(gauge)].store(value, std::memory_order_relaxed);
+        }
+
+        /* Close the current frame, made of the closed update-side counts and
+         * the render-side ones: publish its snapshot and feed the sink */
+        static void endFrame (void) {
+            if (!enabled.load(std::memory_order_relaxed)) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(snapshotMutex);
+            snapshot.frame++;
+            for (int i = 0; i < StatsSnapshot::counter_num; ++i) {
+                snapshot.perFrame[i] = closedUpdateCounters[i] + renderCounters[i].exchange(0, std::memory_order_relaxed);
+                closedUpdateCounters[i] = 0;
+                snapshot.total[i] += snapshot.perFrame[i];
+            }
+            for (int i = 0; i < StatsSnapshot::gauge_num; ++i) {
+                snapshot.gauges[i] = gauges[i].load(std::memory_order_relaxed);
+            }
+            if (sink != nullptr) {
+                sink->write(snapshot);
+            }
+        }
+
+        /* Counters of the last finished frame and totals up to it */
+        static StatsSnapshot getSnapshot (void) {
+            std::lock_guard<std::mutex> lock(snapshotMutex);
+            return snapshot;
+        }
+
+        /**************************** PRIVATE *********************************/
+        private:
+        static std::atomic<bool> enabled;
+        static std::atomic<uint64_t> updateCounters[StatsSnapshot::counter_num];
+        static std::atomic<uint64_t> renderCounters[StatsSnapshot::counter_num];
+        static thread_local bool isRenderThread;
+        static std::atomic<int64_t> gauges[StatsSnapshot::gauge_num];
+
+        static std::mutex snapshotMutex;
+        static uint64_t closedUpdateCounters[StatsSnapshot::counter_num];
+        static StatsSnapshot snapshot;
+        static StatsSink* sink;
+    };
+
+    /************************** INITIALIZATION ********************************/
+    std::atomic<bool> Stats::enabled(false);
+    std::atomic<uint64_t> Stats::updateCounters[StatsSnapshot::counter_num] = {};
+    std::atomic<uint64_t> Stats::renderCounters[StatsSnapshot::counter_num] = {};
+    thread_local bool Stats::isRenderThread = false;
+    std::atomic<int64_t> Stats::gauges[StatsSnapshot::gauge_num] = {};
+    std::mutex Stats::snapshotMutex;
+    uint64_t Stats::closedUpdateCounters[StatsSnapshot::counter_num] = {};
+    StatsSnapshot Stats::snapshot;
+    StatsSink* Stats::sink = nullptr;
+}
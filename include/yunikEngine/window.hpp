@@ -1,11 +1,18 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <cstdio>
+#include <mutex>
+#include <thread>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include "dynamicResolution.hpp"
+#include "input.hpp"
 #include "math.hpp"
 #include "projectManager.hpp"
 #include "scene.hpp"
+#include "stats.hpp"
 
 namespace yunikEngine {
     class Window {
@@ -21,6 +28,11 @@ namespace yunikEngine {
             *minor = gl_version_minor;
         }
 
+        /* MSAA samples of the window's default framebuffer. Call before init */
+        static void setSamples (int samples) {
+            gl_samples = samples;
+        }
+
         static char* getGLSLCore (void) {
             char* glsl_core = new char[19];
             sprintf(glsl_core, "#version %d%d0 core\n", gl_version_major, gl_version_minor);
@@ -52,7 +64,7 @@ namespace yunikEngine {
             glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 
             /* Anti-aliasing */
-            glfwWindowHint(GLFW_SAMPLES, 4);
+            glfwWindowHint(GLFW_SAMPLES, gl_samples);
 
             return true;
         }
@@ -113,18 +125,67 @@ namespace yunikEngine {
             isViewportFull = isFull;
         }
 
+        void setThreadedRendering (bool isThreaded) {
+            isRenderThreaded = isThreaded;
+        }
+
+        void setInputPollInterval (double seconds) {
+            input_poll_interval = seconds;
+        }
+
+        InputQueue* getInputQueue (void) {
+            return &inputQueue;
+        }
+
+        /* Seconds between the newest input consumed by a frame and the return
+         * of the buffer swap presenting that frame */
+        double getInputLatency (void) {
+            return inputLatency.load(std::memory_order_relaxed);
+        }
+
+        /* Render scenes offscreen at a resolution driven by GPU frame time.
+         * Needs a single-sampled window: see setSamples */
+        bool enableDynamicResolution (int samples, UpscaleFilter filter) {
+            disableDynamicResolution();
+            dynamicResolution = DynamicResolution::create(samples, filter);
+            return dynamicResolution != nullptr;
+        }
+
+        void disableDynamicResolution (void) {
+            if (dynamicResolution != nullptr) {
+                dynamicResolution->destroy();
+                dynamicResolution = nullptr;
+            }
+        }
+
+        DynamicResolution* getDynamicResolution (void) {
+            return dynamicResolution;
+        }
+
         void setScene (Scene* newScene) {
             if (scene != nullptr) {
                 delete scene;
             }
             scene = newScene;
+            Stats::add(StatCounter::SCENE_SWITCHES);
         }
 
         void render (void) {
+            if (isRenderThreaded) {
+                renderThreaded();
+                return;
+            }
+
             while (!glfwWindowShouldClose(window)) {
-                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                beginFrame(viewport);
+                const double frameInputTime = lastInputTime;
                 updateScene();
+                drawScene();
+                endFrame();
                 glfwSwapBuffers(window);
+                recordInputLatency(frameInputTime);
+                Stats::closeUpdate();
+                recordFrameStats();
                 glfwPollEvents();
             }
         }
@@ -165,10 +226,19 @@ namespace yunikEngine {
 
             /* Viewport setting */
             setViewportFullWindow(false);
+            viewport[2] = default_window_width;
+            viewport[3] = default_window_height;
 
             /* Window size change callback */
             glfwSetWindowSizeCallback(window, &windowSizeCallback);
 
+            /* Input callbacks */
+            glfwSetKeyCallback(window, &keyCallback);
+            glfwSetCharCallback(window, &charCallback);
+            glfwSetMouseButtonCallback(window, &mouseButtonCallback);
+            glfwSetCursorPosCallback(window, &cursorPosCallback);
+            glfwSetScrollCallback(window, &scrollCallback);
+
             /* Initialize glew */
             GLenum errorCode = glewInit();
             if (errorCode != GLEW_OK) {
@@ -197,6 +267,7 @@ namespace yunikEngine {
         }
 
         ~Window (void) {
+            disableDynamicResolution();
             if (window != nullptr) {
                 glfwDestroyWindow(window);
             }
@@ -209,31 +280,225 @@ namespace yunikEngine {
             }
             Scene* nextScene = scene->update();
             if (nextScene != scene) {
-                delete scene;
+                if (isRenderThreadRunning) {
+                    /* The old scene may own GL objects: let the render thread,
+                     * which owns the context, delete it */
+                    retiredScene = scene;
+                } else {
+                    delete scene;
+                }
                 scene = nextScene;
+                Stats::add(StatCounter::SCENE_SWITCHES);
+            }
+        }
+
+        void beginFrame (const GLint frameViewport[4]) {
+            if (dynamicResolution != nullptr) {
+                dynamicResolution->begin(frameViewport);
+            }
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
+
+        void endFrame (void) {
+            if (dynamicResolution != nullptr) {
+                dynamicResolution->end();
+            }
+        }
+
+        void drawScene (void) {
+            if (scene == nullptr) {
+                return;
+            }
+            scene->draw();
+        }
+
+        void recordInputLatency (double frameInputTime) {
+            if (frameInputTime <= lastPresentedInputTime) {
+                return;
+            }
+            lastPresentedInputTime = frameInputTime;
+            inputLatency.store(glfwGetTime() - frameInputTime, std::memory_order_relaxed);
+        }
+
+        void recordFrameStats (void) {
+            if (!Stats::isEnabled()) {
+                return;
+            }
+            const double now = glfwGetTime();
+            if (lastFrameTime > 0.0) {
+                Stats::setGauge(StatGauge::FRAME_TIME_US, (int64_t) ((now - lastFrameTime) * 1e6));
+            }
+            lastFrameTime = now;
+            Stats::setGauge(StatGauge::INPUT_LATENCY_US, (int64_t) (getInputLatency() * 1e6));
+            if (dynamicResolution != nullptr) {
+                Stats::setGauge(StatGauge::RESOLUTION_SCALE_PERMILLE, (int64_t) (dynamicResolution->getScale() * 1000.0f));
+            }
+            Stats::endFrame();
+        }
+
+        /* Main thread: poll events at a high rate and run Scene::update for
+         * frame N+1 while the render thread waits on the swap of frame N */
+        void renderThreaded (void) {
+            glfwMakeContextCurrent(nullptr);
+            {
+                std::lock_guard<std::mutex> lock(frameMutex);
+                isRenderThreadRunning = true;
+                isFramePending = false;
+            }
+            std::thread renderThread(&Window::renderLoop, this);
+
+            while (!glfwWindowShouldClose(window)) {
+                glfwWaitEventsTimeout(input_poll_interval);
+
+                {
+                    std::lock_guard<std::mutex> lock(frameMutex);
+                    if (isFramePending) {
+                        continue;
+                    }
+                }
+
+                const double frameInputTime = lastInputTime;
+                updateScene();
+
+                {
+                    std::lock_guard<std::mutex> lock(frameMutex);
+                    pendingInputTime = frameInputTime;
+                    isFramePending = true;
+                }
+                frameCondition.notify_one();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(frameMutex);
+                isRenderThreadRunning = false;
+            }
+            frameCondition.notify_one();
+            renderThread.join();
+
+            glfwMakeContextCurrent(window);
+            delete retiredScene;
+            retiredScene = nullptr;
+        }
+
+        /* Render thread: owns the GL context, draws and swaps */
+        void renderLoop (void) {
+            glfwMakeContextCurrent(window);
+            Stats::setRenderThread(true);
+
+            while (true) {
+                Scene* sceneToDelete;
+                double frameInputTime;
+                GLint frameViewport[4];
+                {
+                    std::unique_lock<std::mutex> lock(frameMutex);
+                    frameCondition.wait(lock, [this]() {
+                        return isFramePending || !isRenderThreadRunning;
+                    });
+                    if (!isRenderThreadRunning) {
+                        break;
+                    }
+                    sceneToDelete = retiredScene;
+                    retiredScene = nullptr;
+                    frameInputTime = pendingInputTime;
+
+                    /* The main thread is idle until isFramePending drops:
+                     * everything it counted so far belongs to this frame */
+                    Stats::closeUpdate();
+                    if (isViewportDirty) {
+                        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+                        isViewportDirty = false;
+                    }
+                    for (int i = 0; i < 4; ++i) {
+                        frameViewport[i] = viewport[i];
+                    }
+                }
+
+                delete sceneToDelete;
+
+                beginFrame(frameViewport);
+                drawScene();
+                endFrame();
+
+                /* Scene state is no longer read: release the main thread */
+                {
+                    std::lock_guard<std::mutex> lock(frameMutex);
+                    isFramePending = false;
+                }
+                glfwPostEmptyEvent();
+
+                glfwSwapBuffers(window);
+                recordInputLatency(frameInputTime);
+                recordFrameStats();
+            }
+
+            glfwMakeContextCurrent(nullptr);
+        }
+
+        void setViewport (GLint x, GLint y, GLsizei w, GLsizei h) {
+            std::lock_guard<std::mutex> lock(frameMutex);
+            viewport[0] = x;
+            viewport[1] = y;
+            viewport[2] = w;
+            viewport[3] = h;
+            if (isRenderThreadRunning) {
+                isViewportDirty = true;
+            } else {
+                glViewport(x, y, w, h);
             }
         }
 
+        void pushInputEvent (InputEvent event) {
+            event.timestamp = glfwGetTime();
+            lastInputTime = event.timestamp;
+            inputQueue.push(event);
+        }
+
         static void windowSizeCallback (GLFWwindow* window, int w, int h) {
             Window* windowObj = (Window*) glfwGetWindowUserPointer(window);
             if (windowObj->isViewportFull) {
-                glViewport(0, 0, w, h);
+                windowObj->setViewport(0, 0, w, h);
             } else {
                 GLfloat widthFactor = (GLfloat)w / (GLfloat)windowObj->default_window_width;
                 GLfloat heightFactor = (GLfloat)h / (GLfloat)windowObj->default_window_height;
 
                 if (widthFactor < heightFactor) {
                     GLint modifiedHeight = round(windowObj->default_window_height * widthFactor);
-                    glViewport(0, round((h - modifiedHeight) / 2.0), w, modifiedHeight);
+                    windowObj->setViewport(0, round((h - modifiedHeight) / 2.0), w, modifiedHeight);
                 } else {
                     GLint modifiedWidth =  round(windowObj->default_window_width * heightFactor);
-                    glViewport(round((w - modifiedWidth) / 2.0), 0, modifiedWidth, h);
+                    windowObj->setViewport(round((w - modifiedWidth) / 2.0), 0, modifiedWidth, h);
                 }
             }
         }
 
+        static void keyCallback (GLFWwindow* window, int key, int scancode, int action, int mods) {
+            Window* windowObj = (Window*) glfwGetWindowUserPointer(window);
+            windowObj->pushInputEvent({InputEventType::KEY, key, scancode, action, mods, 0.0, 0.0, 0.0});
+        }
+
+        static void charCallback (GLFWwindow* window, unsigned int codepoint) {
+            Window* windowObj = (Window*) glfwGetWindowUserPointer(window);
+            windowObj->pushInputEvent({InputEventType::CHAR, (int) codepoint, 0, 0, 0, 0.0, 0.0, 0.0});
+        }
+
+        static void mouseButtonCallback (GLFWwindow* window, int button, int action, int mods) {
+            Window* windowObj = (Window*) glfwGetWindowUserPointer(window);
+            windowObj->pushInputEvent({InputEventType::MOUSE_BUTTON, button, 0, action, mods, 0.0, 0.0, 0.0});
+        }
+
+        static void cursorPosCallback (GLFWwindow* window, double x, double y) {
+            Window* windowObj = (Window*) glfwGetWindowUserPointer(window);
+            windowObj->pushInputEvent({InputEventType::CURSOR_POS, 0, 0, 0, 0, x, y, 0.0});
+        }
+
+        static void scrollCallback (GLFWwindow* window, double x, double y) {
+            Window* windowObj = (Window*) glfwGetWindowUserPointer(window);
+            windowObj->pushInputEvent({InputEventType::SCROLL, 0, 0, 0, 0, x, y, 0.0});
+        }
+
         static int gl_version_major;
         static int gl_version_minor;
+        static int gl_samples;
 
         int default_window_width = 1024;
         int default_window_height = 768;
@@ -243,10 +508,36 @@ namespace yunikEngine {
         GLFWwindow* window = nullptr;
         Scene* scene = nullptr;
 
+        DynamicResolution* dynamicResolution = nullptr;
+
+        /* Threaded rendering */
+        bool isRenderThreaded = false;
+        double input_poll_interval = 0.001;
+
+        std::mutex frameMutex;
+        std::condition_variable frameCondition;
+        bool isRenderThreadRunning = false;
+        bool isFramePending = false;
+        double pendingInputTime = 0.0;
+        Scene* retiredScene = nullptr;
+
+        bool isViewportDirty = false;
+        GLint viewport[4] = {0, 0, 0, 0};
+
+        /* Input */
+        InputQueue inputQueue;
+        double lastInputTime = 0.0;
+        double lastPresentedInputTime = 0.0;
+        std::atomic<double> inputLatency {0.0};
+
+        /* Render thread side in threaded mode */
+        double lastFrameTime = 0.0;
+
         bool isValid = false;
     };
 
     /************************** INITIALIZATION ********************************/
     int Window::gl_version_major = 4;
     int Window::gl_version_minor = 4;
+    int Window::gl_samples = 4;
 }
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace yunikEngine {
+    /**************************************************************************/
+    /*                               WorkerPool                               */
+    /**************************************************************************/
+    /* Persistent threads for per-frame parallel loops, so a frame does not
+     * pay thread startup. The calling thread takes part in every run, so a
+     * pool of N threads keeps N - 1 of its own. */
+    class WorkerPool {
+        /***************************** PUBLIC *********************************/
+        public:
+        /* 0 means hardware concurrency */
+        static WorkerPool* create (int threadCount) {
+            return new WorkerPool(threadCount);
+        }
+
+        void destroy (void) {
+            delete this;
+        }
+
+        int getThreadCount (void) {
+            return (int) threads.size() + 1;
+        }
+
+        /* Call task(0) .. task(taskCount - 1) across the pool and return once
+         * all of them are done. Tasks are claimed one at a time, so keep them
+         * coarse. */
+        void run (int taskCount, const std::function<void (int)>& task) {
+            std::unique_lock<std::mutex> lock(mutex);
+            currentTask = &task;
+            nextTask = 0;
+            this->taskCount = taskCount;
+            remainingTasks = taskCount;
+            startCondition.notify_all();
+
+            while (nextTask < this->taskCount) {
+                runNextTask(lock);
+            }
+            doneCondition.wait(lock, [this] { return remainingTasks == 0; });
+            currentTask = nullptr;
+        }
+
+        /**************************** PRIVATE *********************************/
+        private:
+        WorkerPool (int threadCount) {
+            if (threadCount <= 0) {
+                threadCount = (int) std::thread::hardware_concurrency();
+            }
+            for (int i = 1; i < threadCount; ++i) {
+                threads.emplace_back(&WorkerPool::workerLoop, this);
+            }
+        }
+
+        ~WorkerPool (void) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                isStopping = true;
+            }
+            startCondition.notify_all();
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+
+        void workerLoop (void) {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                startCondition.wait(lock, [this] { return isStopping || nextTask < taskCount; });
+                if (isStopping) {
+                    return;
+                }
+                runNextTask(lock);
+            }
+        }
+
+        /* Called with the lock held, runs the task without it */
+        void runNextTask (std::unique_lock<std::mutex>& lock) {
+            const int index = nextTask++;
+            const std::function<void (int)>& task = *currentTask;
+            lock.unlock();
+            task(index);
+            lock.lock();
+            if (--remainingTasks == 0) {
+                doneCondition.notify_all();
+            }
+        }
+
+        std::vector<std::thread> threads;
+
+        std::mutex mutex;
+        std::condition_variable startCondition;
+        std::condition_variable doneCondition;
+        const std::function<void (int)>* currentTask = nullptr;
+        int nextTask = 0;
+        int taskCount = 0;
+        int remainingTasks = 0;
+        bool isStopping = false;
+    };
+}